@@ -0,0 +1,63 @@
+// prints a summary of the live particle state published by ./bin/app --publish
+// build with: make consumer
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include "../src/includes/shared_state.h"
+
+int main(int argc, char* argv[]) {
+    std::string name = argc > 1 ? argv[1] : SHARED_STATE_NAME;
+    SharedStateReader reader;
+    while (!reader.open(name)) {
+        std::cout << "waiting for a publisher on " << name << std::endl;
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+
+    uint64_t lastFrame = UINT64_MAX;
+    while (!reader.publisherClosed()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+
+        // everything is read straight from the mapping; if the publisher lapped us, drop the result and retry
+        SharedFrame frame;
+        if (!reader.latest(frame)) {
+            continue;
+        }
+        uint64_t number = frame.header->frame;
+        float audio = frame.header->audio[0];
+        uint32_t instances = std::min(frame.header->instanceCount, SHARED_STATE_MAX_INSTANCES);
+        float centroidX = 0.0f;
+        float centroidY = 0.0f;
+        uint32_t particles = 0;
+        uint32_t visible = 0;
+        for (uint32_t i = 0; i < instances; ++i) {
+            // the header may be mid-overwrite, so bound the range by the slot rather than trusting count
+            const SharedInstance& instance = frame.header->instances[i];
+            uint32_t end = reader.instanceEnd(instance);
+            for (uint32_t p = instance.first; p < end; ++p) {
+                // particles behind the camera have no screen position
+                if (std::isnan(frame.projected[p * 2])) {
+                    continue;
+                }
+                centroidX += frame.projected[p * 2];
+                centroidY += frame.projected[p * 2 + 1];
+                ++visible;
+            }
+            particles += end > instance.first ? end - instance.first : 0;
+        }
+        if (!reader.validate(frame) || number == lastFrame) {
+            continue;
+        }
+        lastFrame = number;
+        if (visible > 0) {
+            centroidX /= visible;
+            centroidY /= visible;
+        }
+        std::cout << "frame " << number << ": " << particles << " particles in " << instances << " instances, "
+                  << "screen centroid (" << centroidX << ", " << centroidY << "), amplitude " << audio << std::endl;
+    }
+    std::cout << "publisher closed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,145 @@
+#include "alloc_tracker.h"
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#ifdef TRACK_ALLOCATIONS
+
+static std::atomic<uint64_t> allocationCount(0);
+static std::atomic<uint64_t> allocationBytes(0);
+static thread_local bool trackedThread = false;
+
+void trackAllocationsOnThisThread() {
+    trackedThread = true;
+}
+
+static void* countedAllocation(size_t size) {
+    if (trackedThread) {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+        allocationBytes.fetch_add(size, std::memory_order_relaxed);
+    }
+    void* pointer = std::malloc(size ? size : 1);
+    if (!pointer) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void* operator new(size_t size) { return countedAllocation(size); }
+void* operator new[](size_t size) { return countedAllocation(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    try { return countedAllocation(size); } catch (...) { return nullptr; }
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    try { return countedAllocation(size); } catch (...) { return nullptr; }
+}
+void operator delete(void* pointer) noexcept { std::free(pointer); }
+void operator delete[](void* pointer) noexcept { std::free(pointer); }
+void operator delete(void* pointer, size_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { std::free(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { std::free(pointer); }
+
+AllocationCounts allocationTotals() {
+    AllocationCounts counts;
+    counts.count = allocationCount.load(std::memory_order_relaxed);
+    counts.bytes = allocationBytes.load(std::memory_order_relaxed);
+    return counts;
+}
+
+#else
+
+void trackAllocationsOnThisThread() {
+}
+
+AllocationCounts allocationTotals() {
+    return AllocationCounts();
+}
+
+#endif
+
+static AllocationCounts difference(const AllocationCounts& end, const AllocationCounts& start) {
+    AllocationCounts counts;
+    counts.count = end.count - start.count;
+    counts.bytes = end.bytes - start.bytes;
+    return counts;
+}
+
+FrameAllocations::FrameAllocations() : currentCount(0), lastCount(0) {}
+
+void FrameAllocations::beginFrame() {
+    currentCount = 0;
+    frameStart = allocationTotals();
+}
+
+void FrameAllocations::endFrame() {
+    lastFrame = difference(allocationTotals(), frameStart);
+    std::memcpy(last, current, sizeof(Stage) * currentCount);
+    lastCount = currentCount;
+}
+
+void FrameAllocations::beginStage(const char* name, bool amortized) {
+    // a stage entered more than once per frame accumulates into the same slot
+    for (size_t i = 0; i < currentCount; ++i) {
+        if (current[i].name == name) {
+            stageStart[i] = allocationTotals();
+            return;
+        }
+    }
+    if (currentCount == MAX_STAGES) {
+        return;
+    }
+    current[currentCount].name = name;
+    current[currentCount].amortized = amortized;
+    current[currentCount].counts = AllocationCounts();
+    stageStart[currentCount] = allocationTotals();
+    ++currentCount;
+}
+
+void FrameAllocations::endStage(const char* name) {
+    for (size_t i = 0; i < currentCount; ++i) {
+        if (current[i].name == name) {
+            AllocationCounts delta = difference(allocationTotals(), stageStart[i]);
+            current[i].counts.count += delta.count;
+            current[i].counts.bytes += delta.bytes;
+            return;
+        }
+    }
+}
+
+const AllocationCounts& FrameAllocations::frame() const {
+    return lastFrame;
+}
+
+uint64_t FrameAllocations::unexpected() const {
+    uint64_t count = lastFrame.count;
+    for (size_t i = 0; i < lastCount; ++i) {
+        if (last[i].amortized) {
+            count -= last[i].counts.count;
+        }
+    }
+    return count;
+}
+
+size_t FrameAllocations::stageCount() const {
+    return lastCount;
+}
+
+const FrameAllocations::Stage& FrameAllocations::stage(size_t index) const {
+    return last[index];
+}
+
+std::string describeAllocations(const FrameAllocations& allocations) {
+    std::string text = "Allocations/frame: " + std::to_string(allocations.frame().count) + " (" + std::to_string(allocations.frame().bytes) + " B)";
+    for (size_t i = 0; i < allocations.stageCount(); ++i) {
+        const FrameAllocations::Stage& stage = allocations.stage(i);
+        text += std::string(" | ") + stage.name + " " + std::to_string(stage.counts.count);
+    }
+    return text;
+}
+
+FrameAllocations& frameAllocations() {
+    static FrameAllocations tracker;
+    return tracker;
+}
@@ -0,0 +1,82 @@
+#ifndef ALLOC_TRACKER_H
+#define ALLOC_TRACKER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// allocation counting is opt-in: build with -DTRACK_ALLOCATIONS (make instrumented) to hook the global operator new
+#ifdef TRACK_ALLOCATIONS
+const bool ALLOCATION_TRACKING = true;
+#else
+const bool ALLOCATION_TRACKING = false;
+#endif
+
+struct AllocationCounts {
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+};
+
+// only threads that opt in are counted: the render loop's thread and the job system's workers do, background threads
+// like the audio loader, SFML's audio streaming and trajectory writing don't, so their work isn't charged to a frame stage
+void trackAllocationsOnThisThread();
+
+// allocations made by the tracked threads since startup, zero when tracking is compiled out
+AllocationCounts allocationTotals();
+
+// per-frame allocations broken down by pipeline stage, kept in fixed storage so the tracker itself never allocates
+class FrameAllocations {
+public:
+    static const size_t MAX_STAGES = 8;
+
+    struct Stage {
+        const char* name;
+        bool amortized; // expected occasional growth, e.g. Aizawa spawning particles, not counted as a regression
+        AllocationCounts counts;
+    };
+
+    FrameAllocations();
+
+    void beginFrame();
+    void endFrame();
+    void beginStage(const char* name, bool amortized = false);
+    void endStage(const char* name);
+
+    // results of the last completed frame
+    const AllocationCounts& frame() const;
+    // frame allocations minus those of amortized stages
+    uint64_t unexpected() const;
+    size_t stageCount() const;
+    const Stage& stage(size_t index) const;
+
+private:
+    AllocationCounts frameStart;
+    AllocationCounts stageStart[MAX_STAGES];
+    Stage current[MAX_STAGES];
+    Stage last[MAX_STAGES];
+    size_t currentCount;
+    size_t lastCount;
+    AllocationCounts lastFrame;
+};
+
+// the tracker of the render loop, shared by every stage that wants to report itself
+FrameAllocations& frameAllocations();
+
+// "Allocations/frame: 3 (96 B) | audio 0 | simulate 3 | ..." for the HUD and the headless check
+std::string describeAllocations(const FrameAllocations& allocations);
+
+// scoped stage of the current frame
+class AllocationStage {
+public:
+    AllocationStage(const char* name, bool amortized = false) : name(name) {
+        frameAllocations().beginStage(name, amortized);
+    }
+    ~AllocationStage() {
+        frameAllocations().endStage(name);
+    }
+
+private:
+    const char* name;
+};
+
+#endif
@@ -1,8 +1,10 @@
 #include "aizawa.h"
 
-AizawaAttractor::AizawaAttractor(float dt) : Attractor(){
+AizawaAttractor::AizawaAttractor(float dt) : AttractorSystem() {
     this->dt = dt;
     defdt = 0.0000005f;
+    maxdt = 0.1f;
+    stiffness = 4.0f;
     scale = 300.0f;
     offsetX = 0.0f;
     offsetY = -140.0f;
@@ -12,18 +14,17 @@ AizawaAttractor::AizawaAttractor(float dt) : Attractor(){
     defaultaudio = "audio/Debussy - 2 Arabesques, CD 74, L. 66_ No. 1, Andantino con moto.mp3";
     xyswap = true;
     randrange = 0.008f;
+    particlecount = 200;
+    trailsize = 80;
     maxamplitude = 1600.0f;
     startColor = sf::Color(224, 255, 255);
     endColor = sf::Color(239, 204, 144);
 }
 
-std::vector<float> AizawaAttractor::step(const std::vector<float>& point) const {
-    float dx = ((point[2] - b) * point[0] - d * point[1]) * dt;
-    float dy = (d * point[0] + (point[2] - b) * point[1]) * dt;
-    float dz = (c + a * point[2] - point[2] * point[2] * point[2] / 3 - (point[0] * point[0] + point[1] * point[1]) * (1 + e * point[2]) + f * point[2] * point[0] * point[0] * point[0]) * dt;
-    return {point[0] + dx, point[1] + dy, point[2] + dz};
-}
-
 float AizawaAttractor::speedfactor(float dt, float amplitude) const {
     return dt + 0.00002f * amplitude;
-}
\ No newline at end of file
+}
+
+std::vector<std::pair<std::string, float>> AizawaAttractor::parameters() const {
+    return {{"a", a}, {"b", b}, {"c", c}, {"d", d}, {"e", e}, {"f", f}};
+}
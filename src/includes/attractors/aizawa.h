@@ -4,13 +4,21 @@
 #include <vector>
 #include "base_attractor.h"
 
-class AizawaAttractor : public Attractor {
+class AizawaAttractor : public AttractorSystem<AizawaAttractor> {
 
 public:
     AizawaAttractor(float dt);
-    float dt;
-    std::vector<float> step(const std::vector<float>& point) const override;
     float speedfactor(float dt, float amplitude) const override;
+    std::vector<std::pair<std::string, float>> parameters() const override;
+    // dx/dt, dy/dt and dz/dt, the same equations for float and double state
+    template <typename T>
+    std::array<T, 3> velocity(const std::array<T, 3>& point) const {
+        return {
+            (point[2] - b) * point[0] - d * point[1],
+            d * point[0] + (point[2] - b) * point[1],
+            c + a * point[2] - point[2] * point[2] * point[2] / 3 - (point[0] * point[0] + point[1] * point[1]) * (1 + e * point[2]) + f * point[2] * point[0] * point[0] * point[0]
+        };
+    }
 
 private:
     float a = 0.95f;
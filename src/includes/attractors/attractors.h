@@ -1,16 +1,50 @@
 #ifndef ATTRACTORS_H
 #define ATTRACTORS_H
 
+#include <memory>
+#include <string>
 #include "lorenz.h"
 #include "aizawa.h"
 #include "thomas.h"
 #include "halvorsen.h"
 #include "sprott.h"
 
-float lorenz_defdt = 0.0005f;
-float aizawa_defdt = 0.0000005f;
-float thomas_defdt = 0.003f;
-float halvorsen_defdt = 0.00035f;
-float sprott_defdt = 0.0000005f;
+const float lorenz_defdt = 0.0005f;
+const float aizawa_defdt = 0.0000005f;
+const float thomas_defdt = 0.003f;
+const float halvorsen_defdt = 0.00035f;
+const float sprott_defdt = 0.0000005f;
 
-#endif
\ No newline at end of file
+// creates an attractor from its menu name ("Lorenz", "Aizawa", ...), nullptr if the name is unknown
+inline std::unique_ptr<Attractor> makeAttractor(const std::string& name) {
+    if(name == "Lorenz") {
+        return std::make_unique<LorenzAttractor>(lorenz_defdt);
+    } else if(name == "Aizawa") {
+        return std::make_unique<AizawaAttractor>(aizawa_defdt);
+    } else if(name == "Thomas") {
+        return std::make_unique<ThomasAttractor>(thomas_defdt);
+    } else if(name == "Halvorsen") {
+        return std::make_unique<HalvorsenAttractor>(halvorsen_defdt);
+    } else if(name == "Sprott") {
+        return std::make_unique<SprottAttractor>(sprott_defdt);
+    }
+    return nullptr;
+}
+
+// fresh copy of an attractor with its own timestep
+inline std::unique_ptr<Attractor> makeAttractor(const Attractor& attractor, float dt) {
+    if (dynamic_cast<const LorenzAttractor*>(&attractor)) {
+        return std::make_unique<LorenzAttractor>(dt);
+    } else if (dynamic_cast<const AizawaAttractor*>(&attractor)) {
+        return std::make_unique<AizawaAttractor>(dt);
+    } else if(dynamic_cast<const ThomasAttractor*>(&attractor)){
+        return std::make_unique<ThomasAttractor>(dt);
+    } else if(dynamic_cast<const HalvorsenAttractor*>(&attractor)){
+        return std::make_unique<HalvorsenAttractor>(dt);
+    } else if(dynamic_cast<const SprottAttractor*>(&attractor)){
+        return std::make_unique<SprottAttractor>(dt);
+    }
+    return nullptr;
+}
+
+#endif
@@ -6,16 +6,40 @@
 #include <vector>
 #include <array>
 #include <string>
+#include <utility>
+#include <cstddef>
 #include <SFML/Graphics.hpp>
 
+// how an instance's particles are integrated
+enum class Precision {
+    Single, // float state, stepped and projected as is
+    Mixed   // double state stepped in double, a float copy is stored for projection and drawing
+};
+
+// below this relative change per step float rounding eats a noticeable part of every step
+const float MIXED_PRECISION_THRESHOLD = 1e-4f;
+
 class Attractor {
 public:
     virtual ~Attractor() = default;
-    virtual std::vector<float> step(const std::vector<float>& point) const = 0;
+    virtual std::array<float, 3> step(const std::array<float, 3>& point) const = 0;
+    virtual std::array<double, 3> step(const std::array<double, 3>& point) const = 0;
+    // steps count points in place, one tight loop per call so the compiler can vectorize it
+    virtual void advance(std::array<float, 3>* points, size_t count) const = 0;
+    virtual void advance(std::array<double, 3>* points, size_t count) const = 0;
     virtual float speedfactor(float dt, float amplitude) const = 0;
+    // name and value of every constant in the equations
+    virtual std::vector<std::pair<std::string, float>> parameters() const = 0;
+
+    // mixed when even the default timestep moves a particle by less than the threshold relative to its position
+    Precision precision() const {
+        return defdt * stiffness < MIXED_PRECISION_THRESHOLD ? Precision::Mixed : Precision::Single;
+    }
 
     float dt;
     float defdt;
+    float maxdt; // cap on the audio driven timestep
+    float stiffness; // rough size of the fastest rate in the equations, per unit of time
     float scale;
     float offsetX;
     float offsetY;
@@ -24,9 +48,45 @@ public:
     std::string defaultaudio;
     bool xyswap;
     float randrange;
+    size_t particlecount;
+    size_t trailsize;
     float maxamplitude;
     sf::Color startColor;
     sf::Color endColor;
+    std::vector<sf::Color> gradientStops; // optional multi-stop gradient, overrides startColor/endColor
 };;
 
-#endif // ATTRACTOR_H
\ No newline at end of file
+// explicit Euler steps for both scalar types from one templated velocity(point) of the derived attractor
+template <typename Derived>
+class AttractorSystem : public Attractor {
+public:
+    std::array<float, 3> step(const std::array<float, 3>& point) const override {
+        return eulerStep(point);
+    }
+    std::array<double, 3> step(const std::array<double, 3>& point) const override {
+        return eulerStep(point);
+    }
+    void advance(std::array<float, 3>* points, size_t count) const override {
+        advanceAll(points, count);
+    }
+    void advance(std::array<double, 3>* points, size_t count) const override {
+        advanceAll(points, count);
+    }
+
+private:
+    template <typename T>
+    inline std::array<T, 3> eulerStep(const std::array<T, 3>& point) const {
+        const T h = static_cast<T>(dt);
+        std::array<T, 3> velocity = static_cast<const Derived&>(*this).velocity(point);
+        return {point[0] + velocity[0] * h, point[1] + velocity[1] * h, point[2] + velocity[2] * h};
+    }
+
+    template <typename T>
+    void advanceAll(std::array<T, 3>* points, size_t count) const {
+        for (size_t i = 0; i < count; ++i) {
+            points[i] = eulerStep(points[i]);
+        }
+    }
+};
+
+#endif // ATTRACTOR_H
@@ -1,8 +1,10 @@
 #include "halvorsen.h"
 
-HalvorsenAttractor::HalvorsenAttractor(float dt) : Attractor() {
+HalvorsenAttractor::HalvorsenAttractor(float dt) : AttractorSystem() {
     this->dt = dt;
     defdt = 0.00035f;
+    maxdt = 0.3f;
+    stiffness = 15.0f;
     scale = 40.0f;
     offsetX = 0.0f;
     offsetY = 0.0f;
@@ -11,18 +13,17 @@ HalvorsenAttractor::HalvorsenAttractor(float dt) : Attractor() {
     defaultaudio = "audio/Grieg -  Peer Gynt Suite No. 1 Op. 46 - I.mp3";
     xyswap = false;
     randrange = 0.02f;
+    particlecount = 800;
+    trailsize = 80;
     maxamplitude = 2500.0f;
     startColor = sf::Color(193, 241, 255);
     endColor = sf::Color(239, 204, 144);
 }
 
-std::vector<float> HalvorsenAttractor::step(const std::vector<float>& point) const {
-    float dx = (-a * point[0] - 4 * point[1] - 4 * point[2] - point[1] * point[1]) * dt;
-    float dy = (-a * point[1] - 4 * point[2] - 4 * point[0] - point[2] * point[2]) * dt;
-    float dz = (-a * point[2] - 4 * point[0] - 4 * point[1] - point[0] * point[0]) * dt;
-    return {point[0] + dx, point[1] + dy, point[2] + dz};
-}
-
 float HalvorsenAttractor::speedfactor(float dt, float amplitude) const {
     return dt + 0.00001f * amplitude;
-}
\ No newline at end of file
+}
+
+std::vector<std::pair<std::string, float>> HalvorsenAttractor::parameters() const {
+    return {{"a", a}};
+}
@@ -5,12 +5,20 @@
 #include <string>
 #include "base_attractor.h"
 
-class HalvorsenAttractor : public Attractor{
+class HalvorsenAttractor : public AttractorSystem<HalvorsenAttractor> {
 public:
     HalvorsenAttractor(float dt);
-    float dt;
-    std::vector<float> step(const std::vector<float>& point) const override;
     float speedfactor(float dt, float amplitude) const override;
+    std::vector<std::pair<std::string, float>> parameters() const override;
+    // dx/dt, dy/dt and dz/dt, the same equations for float and double state
+    template <typename T>
+    std::array<T, 3> velocity(const std::array<T, 3>& point) const {
+        return {
+            -a * point[0] - 4 * point[1] - 4 * point[2] - point[1] * point[1],
+            -a * point[1] - 4 * point[2] - 4 * point[0] - point[2] * point[2],
+            -a * point[2] - 4 * point[0] - 4 * point[1] - point[0] * point[0]
+        };
+    }
 
 private:
     float a = 1.89f;
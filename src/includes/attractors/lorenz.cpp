@@ -1,8 +1,10 @@
 #include "lorenz.h"
 
-LorenzAttractor::LorenzAttractor(float dt) : Attractor(){
+LorenzAttractor::LorenzAttractor(float dt) : AttractorSystem() {
     this->dt = dt;
     defdt = 0.0005f;
+    maxdt = 0.008f;
+    stiffness = 25.0f;
     scale = 17.0f;
     offsetX = 0.0f;
     offsetY = 380.0f;
@@ -11,18 +13,17 @@ LorenzAttractor::LorenzAttractor(float dt) : Attractor(){
     defaultaudio = "audio/Debussy - Dances for Harp and Orchestra Danse profane.mp3";
     xyswap = false;
     randrange = 0.2f;
+    particlecount = 1000;
+    trailsize = 80;
     maxamplitude = 3500.0f;
     startColor = sf::Color(115, 210, 222);
     endColor = sf::Color(216, 17, 89);
 }
 
-std::vector<float> LorenzAttractor::step(const std::vector<float>& point) const {
-    float dx = sigma * (point[1] - point[0]) * dt;
-    float dy = (point[0] * (rho - point[2]) - point[1]) * dt;
-    float dz = (point[0] * point[1] - beta * point[2]) * dt;
-    return {point[0] + dx, point[1] + dy, point[2] + dz};
-}
-
 float LorenzAttractor::speedfactor(float dt, float amplitude) const {
     return dt + 0.000007f * amplitude;
-}
\ No newline at end of file
+}
+
+std::vector<std::pair<std::string, float>> LorenzAttractor::parameters() const {
+    return {{"sigma", sigma}, {"rho", rho}, {"beta", beta}};
+}
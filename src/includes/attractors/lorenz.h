@@ -5,12 +5,20 @@
 #include <string>
 #include "base_attractor.h"
 
-class LorenzAttractor : public Attractor{
+class LorenzAttractor : public AttractorSystem<LorenzAttractor> {
 public:
     LorenzAttractor(float dt);
-    float dt;
-    std::vector<float> step(const std::vector<float>& point) const override;
     float speedfactor(float dt, float amplitude) const override;
+    std::vector<std::pair<std::string, float>> parameters() const override;
+    // dx/dt, dy/dt and dz/dt, the same equations for float and double state
+    template <typename T>
+    std::array<T, 3> velocity(const std::array<T, 3>& point) const {
+        return {
+            sigma * (point[1] - point[0]),
+            point[0] * (rho - point[2]) - point[1],
+            point[0] * point[1] - beta * point[2]
+        };
+    }
 
 private:
     float sigma = 10.0f;
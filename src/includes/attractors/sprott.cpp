@@ -1,8 +1,10 @@
 #include "sprott.h"
 
-SprottAttractor::SprottAttractor(float dt) : Attractor(){
+SprottAttractor::SprottAttractor(float dt) : AttractorSystem() {
     this->dt = dt;
     defdt = 0.000005f;
+    maxdt = 0.1f;
+    stiffness = 2.0f;
     scale = 180.0f;
     offsetX = -20.0f;
     offsetY = 10.0f;
@@ -12,18 +14,17 @@ SprottAttractor::SprottAttractor(float dt) : Attractor(){
     defaultaudio = "audio/Ravel - Pavane pour une infante défunte - M. 19.mp3";
     xyswap = true;
     randrange = 0.02f;
+    particlecount = 800;
+    trailsize = 80;
     maxamplitude = 2500.0f;
     startColor = sf::Color(128, 0, 32);
     endColor = sf::Color(245,245,220);
 }
 
-std::vector<float> SprottAttractor::step(const std::vector<float>& point) const {
-    float dx = (point[1]) * dt;
-    float dy = (-point[0] + point[1] * point[2]) * dt;
-    float dz = (1 - point[1] * point[1]) * dt;
-    return {point[0] + dx, point[1] + dy, point[2] + dz};
-}
-
 float SprottAttractor::speedfactor(float dt, float amplitude) const {
     return dt + 0.00002f * amplitude;
-}
\ No newline at end of file
+}
+
+std::vector<std::pair<std::string, float>> SprottAttractor::parameters() const {
+    return {{"a", a}, {"b", b}};
+}
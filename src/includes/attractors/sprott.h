@@ -4,13 +4,21 @@
 #include <vector>
 #include "base_attractor.h"
 
-class SprottAttractor : public Attractor {
+class SprottAttractor : public AttractorSystem<SprottAttractor> {
 
 public:
     SprottAttractor(float dt);
-    float dt;
-    std::vector<float> step(const std::vector<float>& point) const override;
     float speedfactor(float dt, float amplitude) const override;
+    std::vector<std::pair<std::string, float>> parameters() const override;
+    // dx/dt, dy/dt and dz/dt, the same equations for float and double state
+    template <typename T>
+    std::array<T, 3> velocity(const std::array<T, 3>& point) const {
+        return {
+            point[1],
+            -point[0] + point[1] * point[2],
+            1 - point[1] * point[1]
+        };
+    }
 
 private:
     float a = 2.07f;
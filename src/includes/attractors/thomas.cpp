@@ -1,8 +1,10 @@
 #include "thomas.h"
 
-ThomasAttractor::ThomasAttractor(float dt) : Attractor() {
+ThomasAttractor::ThomasAttractor(float dt) : AttractorSystem() {
     this->dt = dt;
     defdt = 0.003f;
+    maxdt = 0.3f;
+    stiffness = 1.0f;
     scale = 140.0f;
     offsetX = 0.0f;
     offsetY = 0.0f;
@@ -11,18 +13,17 @@ ThomasAttractor::ThomasAttractor(float dt) : Attractor() {
     defaultaudio = "audio/Beethoven - Moonlight Sonata Adagio.mp3";
     xyswap = false;
     randrange = 0.02f;
+    particlecount = 800;
+    trailsize = 80;
     maxamplitude = 2000.0f;
     startColor = sf::Color(70, 130, 180);
     endColor = sf::Color(239, 204, 144);
 }
 
-std::vector<float> ThomasAttractor::step(const std::vector<float>& point) const {
-    float dx = (sin(point[1]) - b * point[0]) * dt;
-    float dy = (sin(point[2]) - b * point[1]) * dt;
-    float dz = (sin(point[0]) - b * point[2]) * dt;
-    return {point[0] + dx, point[1] + dy, point[2] + dz};
-}
-
 float ThomasAttractor::speedfactor(float dt, float amplitude) const {
     return dt + 0.0001f * amplitude;
-}
\ No newline at end of file
+}
+
+std::vector<std::pair<std::string, float>> ThomasAttractor::parameters() const {
+    return {{"b", b}};
+}
@@ -5,12 +5,20 @@
 #include <string>
 #include "base_attractor.h"
 
-class ThomasAttractor : public Attractor{
+class ThomasAttractor : public AttractorSystem<ThomasAttractor> {
 public:
     ThomasAttractor(float dt);
-    float dt;
-    std::vector<float> step(const std::vector<float>& point) const override;
     float speedfactor(float dt, float amplitude) const override;
+    std::vector<std::pair<std::string, float>> parameters() const override;
+    // dx/dt, dy/dt and dz/dt, the same equations for float and double state
+    template <typename T>
+    std::array<T, 3> velocity(const std::array<T, 3>& point) const {
+        return {
+            std::sin(point[1]) - b * point[0],
+            std::sin(point[2]) - b * point[1],
+            std::sin(point[0]) - b * point[2]
+        };
+    }
 
 private:
     float b = 0.208186f;
@@ -0,0 +1,378 @@
+#include "audio_player.h"
+#include <iostream>
+#include <fstream>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+#include <filesystem>
+
+static bool isAudioFile(const std::__fs::filesystem::path& path) {
+    std::string extension = path.extension().string();
+    return extension == ".mp3" || extension == ".ogg" || extension == ".wav" || extension == ".flac";
+}
+
+// a directory of audio files, a list file with one path per line (relative to the list) or a single file
+static std::vector<std::string> listTracks(const std::string& path) {
+    std::__fs::filesystem::path fsPath(path);
+    std::vector<std::string> tracks;
+    if (std::__fs::filesystem::is_directory(fsPath)) {
+        for (const auto& entry : std::__fs::filesystem::directory_iterator(fsPath)) {
+            if (entry.is_regular_file() && isAudioFile(entry.path())) {
+                tracks.push_back(entry.path().string());
+            }
+        }
+        std::sort(tracks.begin(), tracks.end());
+    } else if (fsPath.extension() == ".txt" || fsPath.extension() == ".m3u") {
+        std::ifstream file(path);
+        std::string line;
+        while (std::getline(file, line)) {
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            if (line.empty() || line[0] == '#') {
+                continue;
+            }
+            std::__fs::filesystem::path entry(line);
+            tracks.push_back(entry.is_absolute() ? line : (fsPath.parent_path() / entry).string());
+        }
+    } else {
+        tracks.push_back(path);
+    }
+    return tracks;
+}
+
+// linear resampling plus channel up/down mixing into the stream format
+static std::vector<sf::Int16> convert(const std::vector<sf::Int16>& in, unsigned inChannels, unsigned inRate, unsigned outChannels, unsigned outRate) {
+    size_t inFrames = in.size() / inChannels;
+    size_t outFrames = static_cast<size_t>(static_cast<double>(inFrames) * outRate / inRate);
+    std::vector<sf::Int16> out(outFrames * outChannels);
+
+    auto sample = [&](size_t frame, unsigned channel) -> float {
+        const sf::Int16* source = &in[frame * inChannels];
+        if (outChannels == 1 && inChannels > 1) {
+            float sum = 0.0f;
+            for (unsigned c = 0; c < inChannels; ++c) {
+                sum += source[c];
+            }
+            return sum / inChannels;
+        }
+        return source[std::min(channel, inChannels - 1)];
+    };
+
+    for (size_t frame = 0; frame < outFrames; ++frame) {
+        double position = static_cast<double>(frame) * inRate / outRate;
+        size_t i0 = std::min(static_cast<size_t>(position), inFrames - 1);
+        size_t i1 = std::min(i0 + 1, inFrames - 1);
+        float t = static_cast<float>(position - i0);
+        for (unsigned c = 0; c < outChannels; ++c) {
+            out[frame * outChannels + c] = static_cast<sf::Int16>(sample(i0, c) + t * (sample(i1, c) - sample(i0, c)));
+        }
+    }
+    return out;
+}
+
+PlaylistStream::PlaylistStream() : previousStart(0), currentStart(0), position(0), streamSamples(0) {}
+
+PlaylistStream::~PlaylistStream() {
+    // the streaming thread calls onGetData, so it has to stop before this object goes away
+    stop();
+}
+
+void PlaylistStream::setFormat(unsigned channels, unsigned sampleRate) {
+    // 50 ms chunks, also the length of the silence served if a prefetch is ever late
+    silence.assign(channels * sampleRate / 20, 0);
+    initialize(channels, sampleRate);
+}
+
+bool PlaylistStream::queue(std::shared_ptr<const Track> track) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (next) {
+        return false;
+    }
+    next = std::move(track);
+    return true;
+}
+
+bool PlaylistStream::hasQueued() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return next || previous;
+}
+
+std::shared_ptr<const Track> PlaylistStream::audible(size_t& samplePos, std::shared_ptr<const Track>& retired) {
+    sf::Uint64 played = static_cast<sf::Uint64>(getPlayingOffset().asMicroseconds()) * getSampleRate() / 1000000 * getChannelCount();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (previous && played < currentStart) {
+        samplePos = static_cast<size_t>(played - previousStart);
+        return previous;
+    }
+    if (previous) {
+        retired = std::move(previous);
+        previous.reset();
+    }
+    samplePos = played >= currentStart ? static_cast<size_t>(played - currentStart) : 0;
+    return current;
+}
+
+bool PlaylistStream::onGetData(Chunk& data) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // switch to the queued track inside the same callback, so the device never runs dry at the boundary
+    if ((!current || position >= current->samples.size()) && next) {
+        if (current) {
+            previous = std::move(current);
+            previousStart = currentStart;
+        }
+        current = std::move(next);
+        next.reset();
+        currentStart = streamSamples;
+        position = 0;
+    }
+
+    if (current && position < current->samples.size()) {
+        data.samples = &current->samples[position];
+        data.sampleCount = std::min<size_t>(silence.size(), current->samples.size() - position);
+        position += data.sampleCount;
+    } else {
+        data.samples = silence.data();
+        data.sampleCount = silence.size();
+    }
+    streamSamples += data.sampleCount;
+    return true;
+}
+
+void PlaylistStream::onSeek(sf::Time timeOffset) {
+    std::lock_guard<std::mutex> lock(mutex);
+    sf::Uint64 target = static_cast<sf::Uint64>(timeOffset.asMicroseconds()) * getSampleRate() / 1000000 * getChannelCount();
+    position = current ? std::min<sf::Uint64>(target, current->samples.size()) : 0;
+}
+
+AudioPlayer::AudioPlayer()
+    : nextTrack(0), channelCount(0), sampleRate(0), samplePos(0), currentAmplitude(0.0f), paused(false), state(Idle), stopping(false) {}
+
+AudioPlayer::~AudioPlayer() {
+    {
+        std::lock_guard<std::mutex> lock(loaderMutex);
+        stopping = true;
+    }
+    loaderWake.notify_all();
+    if (loader.joinable()) {
+        loader.join();
+    }
+}
+
+void AudioPlayer::loadAsync(const std::string& path, StartupReport* report) {
+    tracks = listTracks(path);
+    if (tracks.empty()) {
+        std::cerr << "Error loading audio: no tracks in " << path << std::endl;
+        state = Failed;
+        return;
+    }
+    songTitle = std::__fs::filesystem::path(tracks[0]).filename().string();
+    state = Loading;
+    loader = std::thread(&AudioPlayer::loaderLoop, this, report);
+}
+
+std::shared_ptr<Track> AudioPlayer::decode(const std::string& path, StartupReport* report) {
+    std::__fs::filesystem::path fsPath(path);
+    sf::InputSoundFile file;
+    if (report) report->begin("audio decode");
+    if (!isAudioFile(fsPath) || !file.openFromFile(path) || file.getSampleCount() == 0) {
+        if (report) report->end("audio decode");
+        std::cerr << "Error loading audio " << path << std::endl;
+        return nullptr;
+    }
+    auto track = std::make_shared<Track>();
+    track->title = fsPath.filename().string();
+    track->samples.resize(file.getSampleCount());
+    track->samples.resize(file.read(track->samples.data(), track->samples.size()));
+    if (report) report->end("audio decode");
+
+    if (report) report->begin("audio analysis");
+    // the first track fixes the stream format, later ones are converted to it
+    if (channelCount == 0) {
+        channelCount = file.getChannelCount();
+        sampleRate = file.getSampleRate();
+    } else if (file.getChannelCount() != channelCount || file.getSampleRate() != sampleRate) {
+        track->samples = convert(track->samples, file.getChannelCount(), file.getSampleRate(), channelCount, sampleRate);
+    }
+
+    float maxAmplitude = 0.0f;
+    for (sf::Int16 sample : track->samples) {
+        float absSample = std::abs(static_cast<float>(sample));
+        if (absSample > maxAmplitude) {
+            maxAmplitude = absSample;
+        }
+    }
+    track->maxAmplitude = maxAmplitude;
+    if (report) report->end("audio analysis");
+    return track;
+}
+
+void AudioPlayer::loaderLoop(StartupReport* report) {
+    size_t failures = 0;
+    while (true) {
+        std::vector<std::shared_ptr<const Track>> drop;
+        {
+            std::unique_lock<std::mutex> lock(loaderMutex);
+            if (state != Loading) {
+                loaderWake.wait_for(lock, std::chrono::milliseconds(200), [this] { return stopping || !retired.empty(); });
+            }
+            if (stopping) {
+                return;
+            }
+            drop.swap(retired);
+        }
+        // tracks that finished playing are freed here rather than on the render thread
+        drop.clear();
+
+        // keep at most the playing track and one prefetched track in memory
+        if (state == Decoded || (state == Playing && stream.hasQueued())) {
+            continue;
+        }
+
+        std::shared_ptr<Track> track = decode(tracks[nextTrack], state == Loading ? report : nullptr);
+        nextTrack = (nextTrack + 1) % tracks.size();
+        if (!track) {
+            if (++failures >= tracks.size()) {
+                std::cerr << "Error loading audio: no playable tracks" << std::endl;
+                if (state == Loading) {
+                    state = Failed;
+                }
+                return;
+            }
+            continue;
+        }
+        failures = 0;
+
+        if (state == Loading) {
+            first = track;
+            // release publishes the decoded track and the stream format to the render thread
+            state.store(Decoded, std::memory_order_release);
+        } else {
+            stream.queue(track);
+        }
+    }
+}
+
+void AudioPlayer::poll() {
+    if (state.load(std::memory_order_acquire) != Decoded) {
+        return;
+    }
+    stream.setFormat(channelCount, sampleRate);
+    stream.queue(first);
+    first.reset();
+    if (!paused) {
+        stream.play();
+    }
+    state = Playing;
+    loaderWake.notify_all();
+}
+
+bool AudioPlayer::isReady() const {
+    return state == Playing;
+}
+
+void AudioPlayer::setPaused(bool paused) {
+    this->paused = paused;
+    if (!isReady()) {
+        return;
+    }
+    if (paused) {
+        stream.pause();
+    } else {
+        stream.play();
+    }
+}
+
+void AudioPlayer::stop() {
+    if (isReady()) {
+        stream.stop();
+    }
+}
+
+void AudioPlayer::locate() {
+    std::shared_ptr<const Track> finished;
+    std::shared_ptr<const Track> audible = stream.audible(samplePos, finished);
+    samplePos -= samplePos % channelCount;
+    if (audible != playing) {
+        playing = audible;
+        if (playing) {
+            songTitle = playing->title;
+        }
+    }
+    if (finished) {
+        std::lock_guard<std::mutex> lock(loaderMutex);
+        retired.push_back(std::move(finished));
+    }
+    if (finished || !playing) {
+        loaderWake.notify_all();
+    }
+}
+
+float AudioPlayer::getAmplitude() {
+    if (!isReady()) return 0.0f;
+    locate();
+    if (!playing) return 0.0f;
+
+    const std::vector<sf::Int16>& samples = playing->samples;
+    size_t sampleCount = samples.size();
+
+    float amplitudeSum = 0.0f;
+    for (size_t i = samplePos; i < samplePos + 2048 && i < sampleCount; ++i) {
+        amplitudeSum += std::abs(samples[i]);
+    }
+
+    float amplitude = amplitudeSum / 2048.0f;
+    currentAmplitude = amplitude;
+    return amplitude;
+}
+
+float AudioPlayer::getCurrentAmplitude() const {
+    return currentAmplitude;
+}
+
+AudioLevels AudioPlayer::getLevels() {
+    AudioLevels levels;
+    levels.bands[static_cast<size_t>(AudioBand::Full)] = getAmplitude();
+    if (!isReady() || !playing) return levels;
+
+    const std::vector<sf::Int16>& samples = playing->samples;
+    size_t sampleCount = samples.size();
+    if (samplePos + channelCount > sampleCount) return levels;
+
+    // one-pole low-pass filters split the mono mix into three bands
+    const float lowCoefficient = 1.0f - std::exp(-2.0f * M_PI * 200.0f / sampleRate);
+    const float highCoefficient = 1.0f - std::exp(-2.0f * M_PI * 2000.0f / sampleRate);
+    auto mono = [&](size_t i) {
+        float sum = 0.0f;
+        for (unsigned c = 0; c < channelCount; ++c) {
+            sum += samples[i + c];
+        }
+        return sum / channelCount;
+    };
+    float lowState = mono(samplePos), highState = lowState;
+    float lowSum = 0.0f, midSum = 0.0f, highSum = 0.0f;
+    for (size_t i = samplePos; i + channelCount <= samplePos + 2048 && i + channelCount <= sampleCount; i += channelCount) {
+        float value = mono(i);
+        lowState += lowCoefficient * (value - lowState);
+        highState += highCoefficient * (value - highState);
+        lowSum += std::abs(lowState);
+        midSum += std::abs(highState - lowState);
+        highSum += std::abs(value - highState);
+    }
+    // same normalization as the full band, which averages over a fixed window
+    float windowFrames = 2048.0f / channelCount;
+    levels.bands[static_cast<size_t>(AudioBand::Low)] = lowSum / windowFrames;
+    levels.bands[static_cast<size_t>(AudioBand::Mid)] = midSum / windowFrames;
+    levels.bands[static_cast<size_t>(AudioBand::High)] = highSum / windowFrames;
+    return levels;
+}
+
+const std::string& AudioPlayer::getSongTitle() const {
+    return songTitle;
+}
+
+float AudioPlayer::getMaxAmplitude() const {
+    return playing ? playing->maxAmplitude : 0.0f;
+}
@@ -0,0 +1,103 @@
+#ifndef AUDIO_PLAYER_H
+#define AUDIO_PLAYER_H
+
+#include <SFML/Audio.hpp>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "scene.h"
+#include "startup_report.h"
+
+// a fully decoded track, converted to the playlist's stream format
+struct Track {
+    std::string title;
+    std::vector<sf::Int16> samples; // interleaved
+    float maxAmplitude = 0.0f;
+};
+
+// plays queued tracks back to back with no gap between them
+// onGetData runs on SFML's streaming thread, everything shared with it is guarded by one mutex held only for pointer swaps
+class PlaylistStream : public sf::SoundStream {
+public:
+    PlaylistStream();
+    ~PlaylistStream();
+
+    void setFormat(unsigned channels, unsigned sampleRate);
+    // hands over the track to play after the current one, false if one is already queued
+    bool queue(std::shared_ptr<const Track> track);
+    bool hasQueued();
+
+    // the track audible at the current playing offset and the interleaved sample position inside it
+    // also retires the track before it once playback has passed the boundary
+    std::shared_ptr<const Track> audible(size_t& samplePos, std::shared_ptr<const Track>& retired);
+
+protected:
+    bool onGetData(Chunk& data) override;
+    void onSeek(sf::Time timeOffset) override;
+
+private:
+    std::mutex mutex;
+    std::shared_ptr<const Track> previous;
+    std::shared_ptr<const Track> current;
+    std::shared_ptr<const Track> next;
+    sf::Uint64 previousStart; // stream sample index at which each track started
+    sf::Uint64 currentStart;
+    sf::Uint64 position;      // read position inside current
+    sf::Uint64 streamSamples; // samples handed to the audio device so far
+    std::vector<sf::Int16> silence;
+};
+
+class AudioPlayer {
+public:
+    AudioPlayer();
+    ~AudioPlayer();
+
+    // plays a single file, a directory of audio files or a list file with one path per line, repeating at the end
+    // decoding and analysis run on a background thread which always keeps the next track prefetched
+    void loadAsync(const std::string& path, StartupReport* report = nullptr);
+    // called once per frame from the render thread, starts playback as soon as the first track is ready
+    void poll();
+    bool isReady() const;
+
+    void setPaused(bool paused);
+    void stop();
+
+    float getAmplitude();
+    float getCurrentAmplitude() const;
+    // full band amplitude plus low (< 200 Hz), mid and high (> 2 kHz) bands over the same window
+    AudioLevels getLevels();
+    const std::string& getSongTitle() const;
+    float getMaxAmplitude() const;
+
+private:
+    enum State { Idle, Loading, Decoded, Failed, Playing };
+
+    PlaylistStream stream;
+    std::vector<std::string> tracks;
+    size_t nextTrack;
+    unsigned channelCount;
+    unsigned sampleRate;
+    std::shared_ptr<const Track> first;
+    std::shared_ptr<const Track> playing;
+    size_t samplePos;
+    float currentAmplitude;
+    std::string songTitle;
+    bool paused;
+    std::atomic<int> state;
+
+    std::thread loader;
+    std::mutex loaderMutex;
+    std::condition_variable loaderWake;
+    bool stopping;
+    std::vector<std::shared_ptr<const Track>> retired;
+
+    void loaderLoop(StartupReport* report);
+    std::shared_ptr<Track> decode(const std::string& path, StartupReport* report);
+    void locate();
+};
+
+#endif
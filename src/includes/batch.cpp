@@ -0,0 +1,97 @@
+#include "batch.h"
+#include <algorithm>
+#include <cmath>
+#include "alloc_tracker.h"
+
+DrawBatch::DrawBatch(JobSystem& jobs) : depthSorter(jobs), buildCount(0), builtTails(false), builtAdditive(false) {}
+
+uint64_t DrawBatch::version() const {
+    return buildCount;
+}
+
+void DrawBatch::reserve(size_t segments, size_t points) {
+    // trails fill up over the first frames and Aizawa keeps spawning, so grow with headroom in one place
+    if (segmentKeys.capacity() >= segments && pointKeys.capacity() >= points) {
+        return;
+    }
+    AllocationStage stage("batch growth", true);
+    segments = segments * 3 / 2;
+    points = points * 3 / 2;
+    size_t vertices = std::max(segments * 2, points * 4);
+    trailVertices.reserve(vertices);
+    pointVertices.reserve(vertices);
+    unsortedVertices.reserve(vertices);
+    segmentKeys.reserve(segments);
+    pointKeys.reserve(points);
+    depthSorter.reserve(std::max(segments, points));
+}
+
+void DrawBatch::build(const Scene& scene, bool tails, bool additive) {
+    if (buildCount > 0 && scene.unchanged() && tails == builtTails && additive == builtAdditive) {
+        return;
+    }
+    ++buildCount;
+    builtTails = tails;
+    builtAdditive = additive;
+
+    size_t segments = 0;
+    size_t pointCount = 0;
+    for (const auto& instance : scene.instances()) {
+        segments += instance.trails.segmentCount();
+        pointCount += instance.screenPositions.size();
+    }
+    reserve(segments, pointCount);
+
+    trailVertices.clear();
+    if (tails) {
+        unsortedVertices.clear();
+        segmentKeys.clear();
+        for (const auto& instance : scene.instances()) {
+            instance.trails.expand(instance.gradient.lut(), instance.trailAlpha, unsortedVertices, additive ? nullptr : &segmentKeys, &scene.depthRange());
+        }
+        if (additive) {
+            trailVertices.swap(unsortedVertices);
+        } else {
+            const std::vector<uint32_t>& order = depthSorter.sort(segmentKeys.data(), segmentKeys.size());
+            trailVertices.resize(unsortedVertices.size());
+            for (size_t i = 0; i < order.size(); ++i) {
+                trailVertices[i * 2] = unsortedVertices[order[i] * 2];
+                trailVertices[i * 2 + 1] = unsortedVertices[order[i] * 2 + 1];
+            }
+        }
+    }
+
+    // 2x2 px quads, points the camera culled (NaN positions) are skipped
+    pointKeys.resize(pointCount);
+    unsortedVertices.resize(pointCount * 4);
+    size_t drawn = 0;
+    for (const auto& instance : scene.instances()) {
+        const GradientLUT& lut = instance.gradient.lut();
+        for (size_t i = 0; i < instance.screenPositions.size(); ++i) {
+            const sf::Vector2f& p = instance.screenPositions[i];
+            if (std::isnan(p.x)) {
+                continue;
+            }
+            const sf::Color& color = lut[instance.colorIndices[i]];
+            sf::Vertex* quad = &unsortedVertices[drawn * 4];
+            quad[0] = sf::Vertex(sf::Vector2f(p.x - 1.0f, p.y - 1.0f), color);
+            quad[1] = sf::Vertex(sf::Vector2f(p.x + 1.0f, p.y - 1.0f), color);
+            quad[2] = sf::Vertex(sf::Vector2f(p.x + 1.0f, p.y + 1.0f), color);
+            quad[3] = sf::Vertex(sf::Vector2f(p.x - 1.0f, p.y + 1.0f), color);
+            pointKeys[drawn] = instance.depthKeys[i];
+            ++drawn;
+        }
+    }
+    // shrinking never reallocates
+    pointKeys.resize(drawn);
+    unsortedVertices.resize(drawn * 4);
+    if (additive) {
+        pointVertices.swap(unsortedVertices);
+    } else {
+        const std::vector<uint32_t>& order = depthSorter.sort(pointKeys.data(), pointKeys.size());
+        pointVertices.resize(unsortedVertices.size());
+        for (size_t n = 0; n < order.size(); ++n) {
+            std::copy_n(&unsortedVertices[order[n] * 4], 4, &pointVertices[n * 4]);
+        }
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <vector>
+#include <cstdint>
+#include <SFML/Graphics.hpp>
+#include "scene.h"
+#include "radix_sort.h"
+
+// the vertices of a whole scene, one sf::Lines array for the trails and one sf::Quads array for the points
+// buffers are reused between frames, so building a batch of the same size does not allocate
+class DrawBatch {
+public:
+    explicit DrawBatch(JobSystem& jobs);
+
+    // alpha blended batches are sorted back to front, additive ones are left in scene order
+    // the vertices are kept as they are when the scene skipped its update and the options are the same
+    void build(const Scene& scene, bool tails, bool additive);
+    // changes whenever the vertices do, renderers use it to reuse what they drew last
+    uint64_t version() const;
+
+    std::vector<sf::Vertex> trailVertices;
+    std::vector<sf::Vertex> pointVertices;
+
+private:
+    RadixSorter depthSorter;
+    std::vector<uint16_t> segmentKeys;
+    std::vector<uint16_t> pointKeys;
+    std::vector<sf::Vertex> unsortedVertices;
+    uint64_t buildCount;
+    bool builtTails;
+    bool builtAdditive;
+
+    void reserve(size_t segments, size_t points);
+};
+
+#endif
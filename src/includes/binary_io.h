@@ -0,0 +1,18 @@
+#ifndef BINARY_IO_H
+#define BINARY_IO_H
+
+#include <istream>
+#include <ostream>
+
+// raw values in host byte order, files are meant to be read back on the machine that wrote them
+template <typename T>
+inline void writeBinary(std::ostream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+inline bool readBinary(std::istream& in, T& value) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+#endif
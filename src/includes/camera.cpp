@@ -0,0 +1,70 @@
+#include "camera.h"
+#include <cmath>
+
+typedef std::array<double, 9> Matrix3;
+
+static Matrix3 multiply(const Matrix3& a, const Matrix3& b) {
+    Matrix3 result;
+    for (size_t i = 0; i < 3; i++) {
+        for (size_t j = 0; j < 3; j++) {
+            double sum = 0;
+            for (size_t k = 0; k < 3; k++) {
+                sum += a[i * 3 + k] * b[k * 3 + j];
+            }
+            result[i * 3 + j] = sum;
+        }
+    }
+    return result;
+}
+
+Camera::Camera()
+    : projection(Projection::Orthographic), fov(0.7f), eyeDistance(1.0f), rotation(), scale(1.0f), centerX(0.0f), centerY(0.0f),
+      distance(1.0f), nearPlane(0.1f), perspectiveWeight(0.0f)
+{
+}
+
+void Camera::update(float rotationX, float rotationY, float rotationZ, float scale, float screenWidth, float screenHeight, float offsetX, float offsetY) {
+    // fixed size 3x3 matrices, this runs every frame and must not allocate
+    const double cx = std::cos(rotationX), sx = std::sin(rotationX);
+    const double cy = std::cos(rotationY), sy = std::sin(rotationY);
+    const double cz = std::cos(rotationZ), sz = std::sin(rotationZ);
+
+    // Rotation around X-axis
+    const Matrix3 rotationmatrixX = {1, 0, 0,
+                                     0, cx, -sx,
+                                     0, sx, cx};
+    // Rotation around Y-axis
+    const Matrix3 rotationmatrixY = {cy, 0, sy,
+                                     0, 1, 0,
+                                     -sy, 0, cy};
+    // Rotation around Z-axis
+    const Matrix3 rotationmatrixZ = {cz, -sz, 0,
+                                     sz, cz, 0,
+                                     0, 0, 1};
+
+    Matrix3 combined = multiply(multiply(rotationmatrixX, rotationmatrixY), rotationmatrixZ);
+    for (size_t i = 0; i < 9; ++i) {
+        rotation[i] = static_cast<float>(combined[i]);
+    }
+
+    this->scale = scale;
+    centerX = screenWidth / 2.0f - offsetX;
+    centerY = screenHeight / 2.0f + offsetY;
+
+    // eye distance at which the z = 0 plane keeps its orthographic size for this field of view, times eyeDistance
+    distance = eyeDistance * (screenHeight / 2.0f) / std::tan(fov / 2.0f);
+    // an orthographic camera has no eye to get behind, nothing is culled
+    perspectiveWeight = projection == Projection::Perspective ? 1.0f : 0.0f;
+    nearPlane = projection == Projection::Perspective ? 0.1f * distance : std::numeric_limits<float>::lowest();
+}
+
+DepthRange::DepthRange() : nearDepth(0.0f), farDepth(1.0f), invRange(1.0f) {}
+
+void DepthRange::update(float batchMin, float batchMax) {
+    if (batchMax < batchMin) {
+        return;
+    }
+    nearDepth = batchMin;
+    farDepth = batchMax;
+    invRange = farDepth > nearDepth ? 1.0f / (farDepth - nearDepth) : 0.0f;
+}
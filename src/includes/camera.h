@@ -0,0 +1,78 @@
+#ifndef CAMERA_H
+#define CAMERA_H
+
+#include <array>
+#include <cstdint>
+#include <algorithm>
+#include <limits>
+
+enum class Projection {
+    Orthographic,
+    Perspective
+};
+
+// rotation, projection and screen mapping shared by every particle in a frame
+class Camera {
+public:
+    Camera();
+
+    Projection projection;
+    float fov;         // vertical field of view in radians
+    float eyeDistance; // multiple of the distance at which the z = 0 plane keeps its orthographic size for the fov
+
+    // rebuilds the rotation matrix and screen mapping once per frame
+    void update(float rotationX, float rotationY, float rotationZ, float scale, float screenWidth, float screenHeight, float offsetX, float offsetY);
+
+    // distance from the eye to the z = 0 plane in pixels, set by update
+    inline float centreDepth() const {
+        return distance;
+    }
+
+    // projects a point in attractor space; depth is the distance from the eye in pixels
+    // false for points closer than the near plane or behind the eye in perspective, their screen position is NaN
+    inline bool project(float x, float y, float z, float& screenX, float& screenY, float& depth) const {
+        float rx = rotation[0] * x + rotation[1] * y + rotation[2] * z;
+        float ry = rotation[3] * x + rotation[4] * y + rotation[5] * z;
+        float rz = rotation[6] * x + rotation[7] * y + rotation[8] * z;
+
+        depth = distance - rz * scale;
+        if (depth < nearPlane) {
+            screenX = std::numeric_limits<float>::quiet_NaN();
+            screenY = std::numeric_limits<float>::quiet_NaN();
+            return false;
+        }
+        float perspective = perspectiveWeight * (distance / depth) + (1.0f - perspectiveWeight);
+        screenX = rx * scale * perspective + centerX;
+        screenY = ry * scale * perspective + centerY;
+        return true;
+    }
+
+private:
+    std::array<float, 9> rotation;
+    float scale;
+    float centerX;
+    float centerY;
+    float distance;
+    float nearPlane;
+    float perspectiveWeight; // 1 for perspective, 0 for orthographic
+};
+
+// maps depths onto 16-bit sort keys within the depth range of the current frame
+class DepthRange {
+public:
+    DepthRange();
+
+    void update(float batchMin, float batchMax);
+    // back-to-front key: the farthest depth gets the smallest key
+    inline uint16_t key(float depth) const {
+        float t = (farDepth - depth) * invRange;
+        return static_cast<uint16_t>(std::min(std::max(t, 0.0f), 1.0f) * 65535.0f);
+    }
+
+private:
+    float nearDepth;
+    float farDepth;
+    float invRange;
+};
+
+#endif
@@ -0,0 +1,345 @@
+#include "density.h"
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <mutex>
+#include "attractors/attractors.h"
+#include "binary_io.h"
+
+static const char MAGIC[4] = {'C', 'A', 'D', 'H'};
+static const uint16_t VERSION = 2; // 2: particles seeded by a counter-based generator
+
+// frames whose cameras are built at a time, so the camera table stays small whatever --frames is
+static const uint32_t CAMERA_BLOCK = 1024;
+// hits a chunk collects before adding them to a shared histogram under its lock
+static const size_t HIT_BUFFER = 4096;
+// memory the shared histograms may take, past it chunks take turns on fewer of them
+static const size_t HISTOGRAM_BUDGET = size_t(512) << 20;
+
+// a histogram that chunks add their buffered hits to; 64-bit so no pixel can wrap however long the render
+struct SharedHistogram {
+    std::mutex mutex;
+    std::vector<uint64_t> counts;
+};
+
+static void flushHits(std::vector<uint32_t>& hits, SharedHistogram& histogram) {
+    std::lock_guard<std::mutex> lock(histogram.mutex);
+    for (uint32_t pixel : hits) {
+        ++histogram.counts[pixel];
+    }
+    hits.clear();
+}
+
+// steps one particle through a block of frames in the instance's precision and buffers the pixels it lands on
+// the state is kept in double between blocks, which holds a float state exactly
+template <typename T>
+static void traceParticle(const Attractor& stepper, std::array<double, 3>& state, uint64_t firstFrame, uint64_t endFrame,
+                          const std::vector<Camera>& cameras, uint64_t cameraFrame, const DensityOptions& options,
+                          std::vector<uint32_t>& hits, SharedHistogram& histogram) {
+    std::array<T, 3> point = {static_cast<T>(state[0]), static_cast<T>(state[1]), static_cast<T>(state[2])};
+    for (uint64_t frame = firstFrame; frame < endFrame; ++frame) {
+        point = stepper.step(point);
+        if (frame < options.warmup) {
+            continue;
+        }
+        float screenX, screenY, depth;
+        cameras[frame - cameraFrame].project(static_cast<float>(point[0]), static_cast<float>(point[1]), static_cast<float>(point[2]),
+                                             screenX, screenY, depth);
+        // written so that NaN positions are rejected too
+        if (screenX >= 0.0f && screenY >= 0.0f && screenX < options.width && screenY < options.height) {
+            // at most DENSITY_MAX_SIZE squared pixels, which fits 32 bits
+            hits.push_back(static_cast<uint32_t>(static_cast<size_t>(screenY) * options.width + static_cast<size_t>(screenX)));
+            if (hits.size() == HIT_BUFFER) {
+                flushHits(hits, histogram);
+            }
+        }
+    }
+    state = {static_cast<double>(point[0]), static_cast<double>(point[1]), static_cast<double>(point[2])};
+}
+
+void renderDensityShard(Scene& scene, JobSystem& jobs, const std::string& source, const DensityOptions& options,
+                        uint32_t shardIndex, uint32_t shardCount, DensityImage& image) {
+    image.options = options;
+    image.source = source;
+    image.shardIndex = shardIndex;
+    image.shardCount = shardCount;
+    image.instances.clear();
+
+    // a particle's initial point only depends on the seed and its index, so slices never depend on the shard count
+    scene.initializePoints(options.seed);
+    const size_t pixels = static_cast<size_t>(options.width) * options.height;
+    const uint64_t totalFrames = static_cast<uint64_t>(options.warmup) + options.frames;
+
+    // one histogram per chunk when they fit the budget, otherwise chunks share them; the counts are integers,
+    // so the sums come out the same however the hits were split
+    size_t histogramCount = std::min<size_t>(jobs.size(), std::max<size_t>(HISTOGRAM_BUDGET / (pixels * sizeof(uint64_t)), 1));
+    std::vector<SharedHistogram> histograms(histogramCount);
+    std::vector<std::vector<uint32_t>> chunkHits(jobs.size());
+    for (auto& hits : chunkHits) {
+        hits.reserve(HIT_BUFFER);
+    }
+    std::vector<Camera> cameras(CAMERA_BLOCK);
+    std::vector<std::array<double, 3>> states;
+
+    for (AttractorInstance& instance : scene.instances()) {
+        const Attractor& attractor = *instance.attractor;
+        float amplitude = std::min(options.amplitude, 800.0f);
+        std::unique_ptr<Attractor> stepper = makeAttractor(attractor, std::min(attractor.speedfactor(attractor.defdt, amplitude), attractor.maxdt));
+
+        const std::vector<std::array<float, 3>>& points = instance.points;
+        size_t first = points.size() * shardIndex / shardCount;
+        size_t last = points.size() * (shardIndex + 1) / shardCount;
+        states.resize(last - first);
+        for (size_t i = first; i < last; ++i) {
+            states[i - first] = {points[i][0], points[i][1], points[i][2]};
+        }
+        for (SharedHistogram& histogram : histograms) {
+            histogram.counts.assign(pixels, 0);
+        }
+
+        // the view only depends on the frame, so every shard builds the same cameras
+        std::array<float, 3> rotation = instance.rotation;
+        const bool drifting = dynamic_cast<const SprottAttractor*>(&attractor) != nullptr;
+        for (uint64_t blockFrame = 0; blockFrame < totalFrames; blockFrame += CAMERA_BLOCK) {
+            uint64_t blockEnd = std::min(blockFrame + CAMERA_BLOCK, totalFrames);
+            for (uint64_t frame = blockFrame; frame < blockEnd; ++frame) {
+                if (drifting) {
+                    rotation[0] += 0.0003f;
+                    rotation[1] += 0.0001f;
+                }
+                if (frame < options.warmup) {
+                    continue;
+                }
+                Camera& camera = cameras[frame - blockFrame];
+                camera.projection = scene.projection;
+                camera.fov = scene.fov;
+                camera.update(rotation[0], rotation[1], rotation[2], instance.scale, options.width, options.height,
+                              instance.offsetX, instance.offsetY);
+            }
+
+            // each particle runs through the block on its own, hits are buffered per chunk
+            jobs.parallelFor(states.size(), [&](size_t chunk, size_t begin, size_t end) {
+                std::vector<uint32_t>& hits = chunkHits[chunk];
+                SharedHistogram& histogram = histograms[chunk % histograms.size()];
+                for (size_t i = begin; i < end; ++i) {
+                    if (instance.precision == Precision::Mixed) {
+                        traceParticle<double>(*stepper, states[i], blockFrame, blockEnd, cameras, blockFrame, options, hits, histogram);
+                    } else {
+                        traceParticle<float>(*stepper, states[i], blockFrame, blockEnd, cameras, blockFrame, options, hits, histogram);
+                    }
+                }
+                flushHits(hits, histogram);
+            });
+        }
+
+        DensityInstance result;
+        result.attractor = instance.name;
+        result.particles = static_cast<uint32_t>(points.size());
+        result.counts = std::move(histograms[0].counts);
+        jobs.parallelFor(pixels, [&](size_t, size_t begin, size_t end) {
+            for (size_t h = 1; h < histograms.size(); ++h) {
+                const std::vector<uint64_t>& counts = histograms[h].counts;
+                for (size_t p = begin; p < end; ++p) {
+                    result.counts[p] += counts[p];
+                }
+            }
+        });
+        image.instances.push_back(std::move(result));
+    }
+}
+
+static void writeString(std::ostream& out, const std::string& text) {
+    writeBinary(out, static_cast<uint16_t>(text.size()));
+    out.write(text.data(), text.size());
+}
+
+static bool readString(std::istream& in, std::string& text) {
+    uint16_t length;
+    if (!readBinary(in, length)) {
+        return false;
+    }
+    text.resize(length);
+    return length == 0 || static_cast<bool>(in.read(&text[0], length));
+}
+
+bool saveDensityShard(const std::string& path, const DensityImage& image) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cerr << "Error opening " << path << std::endl;
+        return false;
+    }
+    const DensityOptions& options = image.options;
+    file.write(MAGIC, sizeof(MAGIC));
+    writeBinary(file, VERSION);
+    writeBinary(file, static_cast<uint32_t>(options.seed));
+    writeBinary(file, options.frames);
+    writeBinary(file, options.warmup);
+    writeBinary(file, options.width);
+    writeBinary(file, options.height);
+    writeBinary(file, options.amplitude);
+    writeBinary(file, image.shardIndex);
+    writeBinary(file, image.shardCount);
+    writeString(file, image.source);
+    writeBinary(file, static_cast<uint16_t>(image.instances.size()));
+    for (const DensityInstance& instance : image.instances) {
+        writeString(file, instance.attractor);
+        writeBinary(file, instance.particles);
+        file.write(reinterpret_cast<const char*>(instance.counts.data()), instance.counts.size() * sizeof(uint64_t));
+    }
+    file.close();
+    if (!file) {
+        std::cerr << "Error writing " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool loadDensityShard(const std::string& path, DensityImage& image) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Error opening " << path << std::endl;
+        return false;
+    }
+    char magic[sizeof(MAGIC)];
+    uint16_t version;
+    if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || !readBinary(file, version)) {
+        std::cerr << path << " is not a density shard" << std::endl;
+        return false;
+    }
+    if (version != VERSION) {
+        std::cerr << path << ": unsupported density shard version " << version << std::endl;
+        return false;
+    }
+
+    DensityOptions& options = image.options;
+    uint32_t seed;
+    uint16_t instanceCount;
+    if (!readBinary(file, seed) || !readBinary(file, options.frames) || !readBinary(file, options.warmup) ||
+        !readBinary(file, options.width) || !readBinary(file, options.height) || !readBinary(file, options.amplitude) ||
+        !readBinary(file, image.shardIndex) || !readBinary(file, image.shardCount) || !readString(file, image.source) ||
+        !readBinary(file, instanceCount) || image.shardIndex >= image.shardCount ||
+        options.width == 0 || options.height == 0 || options.width > DENSITY_MAX_SIZE || options.height > DENSITY_MAX_SIZE) {
+        std::cerr << path << ": truncated or invalid header" << std::endl;
+        return false;
+    }
+    options.seed = seed;
+
+    const size_t pixels = static_cast<size_t>(options.width) * options.height;
+    image.instances.resize(instanceCount);
+    for (DensityInstance& instance : image.instances) {
+        instance.counts.resize(pixels);
+        if (!readString(file, instance.attractor) || !readBinary(file, instance.particles) ||
+            !file.read(reinterpret_cast<char*>(instance.counts.data()), pixels * sizeof(uint64_t))) {
+            std::cerr << path << ": truncated hit counts" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool sameRender(const DensityImage& a, const DensityImage& b) {
+    if (a.options.seed != b.options.seed || a.options.frames != b.options.frames || a.options.warmup != b.options.warmup ||
+        a.options.width != b.options.width || a.options.height != b.options.height ||
+        a.options.amplitude != b.options.amplitude || a.source != b.source ||
+        a.shardCount != b.shardCount || a.instances.size() != b.instances.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.instances.size(); ++i) {
+        if (a.instances[i].attractor != b.instances[i].attractor || a.instances[i].particles != b.instances[i].particles) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool mergeDensityShards(const std::vector<std::string>& paths, DensityImage& merged) {
+    if (paths.empty()) {
+        std::cerr << "No density shards to merge" << std::endl;
+        return false;
+    }
+    // shards are read one at a time, only the running sum stays in memory
+    std::vector<bool> seen;
+    DensityImage shard;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        if (!loadDensityShard(paths[i], i == 0 ? merged : shard)) {
+            return false;
+        }
+        if (i == 0) {
+            seen.assign(merged.shardCount, false);
+            seen[merged.shardIndex] = true;
+            continue;
+        }
+        if (!sameRender(merged, shard)) {
+            std::cerr << paths[i] << " is from a different render than " << paths[0] << std::endl;
+            return false;
+        }
+        if (seen[shard.shardIndex]) {
+            std::cerr << paths[i] << ": shard " << shard.shardIndex << " is given twice" << std::endl;
+            return false;
+        }
+        seen[shard.shardIndex] = true;
+        for (size_t instance = 0; instance < merged.instances.size(); ++instance) {
+            std::vector<uint64_t>& sum = merged.instances[instance].counts;
+            const std::vector<uint64_t>& counts = shard.instances[instance].counts;
+            for (size_t p = 0; p < sum.size(); ++p) {
+                sum[p] += counts[p];
+            }
+        }
+    }
+    for (uint32_t i = 0; i < merged.shardCount; ++i) {
+        if (!seen[i]) {
+            std::cerr << "Shard " << i << " of " << merged.shardCount << " is missing" << std::endl;
+            return false;
+        }
+    }
+    merged.shardIndex = 0;
+    merged.shardCount = 1;
+    return true;
+}
+
+uint64_t densityHash(const DensityImage& image) {
+    // 64-bit FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+    for (const DensityInstance& instance : image.instances) {
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(instance.counts.data());
+        for (size_t i = 0; i < instance.counts.size() * sizeof(uint64_t); ++i) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ULL;
+        }
+    }
+    return hash;
+}
+
+void toneMapDensity(const DensityImage& image, const Scene& scene, std::vector<sf::Uint8>& pixels) {
+    const size_t count = static_cast<size_t>(image.options.width) * image.options.height;
+    std::vector<float> color(count * 3, 0.0f);
+    for (size_t i = 0; i < image.instances.size(); ++i) {
+        const std::vector<uint64_t>& counts = image.instances[i].counts;
+        const Gradient& gradient = scene.instances()[i].gradient;
+        uint64_t peak = *std::max_element(counts.begin(), counts.end());
+        if (peak == 0) {
+            continue;
+        }
+        // log scale, a pixel hit once is faint and the busiest pixel gets the end of the gradient at full brightness
+        float inverseLogPeak = 1.0f / std::log1p(static_cast<float>(peak));
+        for (size_t p = 0; p < count; ++p) {
+            if (counts[p] == 0) {
+                continue;
+            }
+            float t = std::log1p(static_cast<float>(counts[p])) * inverseLogPeak;
+            const sf::Color& stop = gradient[gradientIndex(t)];
+            color[p * 3] += stop.r * t;
+            color[p * 3 + 1] += stop.g * t;
+            color[p * 3 + 2] += stop.b * t;
+        }
+    }
+    pixels.resize(count * 4);
+    for (size_t p = 0; p < count; ++p) {
+        for (int c = 0; c < 3; ++c) {
+            pixels[p * 4 + c] = static_cast<sf::Uint8>(std::min(color[p * 3 + c], 255.0f) + 0.5f);
+        }
+        pixels[p * 4 + 3] = 255;
+    }
+}
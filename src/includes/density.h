@@ -0,0 +1,62 @@
+#ifndef DENSITY_H
+#define DENSITY_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "scene.h"
+
+// offline density renders: how often each pixel is hit by a particle over many frames
+//
+// the seeded initial set is split into shards that are integrated independently, by separate processes
+// or on separate machines sharing a directory; each shard writes its hit counts to a file and merging
+// sums them; counts are integers and every particle is integrated on its own, so the merged counts are
+// bit-identical whatever the shard count
+//
+// shard files, written in host byte order:
+//   magic, version, seed, frames, warmup, width, height, amplitude, shard index, shard count, source,
+//   then per instance the attractor name, its particle count and width x height 64-bit hit counts
+
+const uint32_t DENSITY_MAX_SIZE = 16384; // pixels along either side
+
+struct DensityOptions {
+    unsigned seed = 1;
+    uint32_t frames = 2000;
+    uint32_t warmup = 200;     // frames integrated before hits are counted, lets the initial cube settle
+    uint32_t width = 1920;
+    uint32_t height = 1080;
+    float amplitude = 400.0f;  // fixed audio level that sets each attractor's timestep
+};
+
+struct DensityInstance {
+    std::string attractor;
+    uint32_t particles = 0;    // in the whole initial set, not just this shard
+    std::vector<uint64_t> counts;
+};
+
+struct DensityImage {
+    DensityOptions options;
+    std::string source;        // attractor name or scene file
+    uint32_t shardIndex = 0;
+    uint32_t shardCount = 1;
+    std::vector<DensityInstance> instances;
+};
+
+// integrates particles [count * index / shards, count * (index + 1) / shards) of every instance's initial set
+// no respawns and a fixed timestep, the view is the attractor's own with its automatic rotation
+void renderDensityShard(Scene& scene, JobSystem& jobs, const std::string& source, const DensityOptions& options,
+                        uint32_t shardIndex, uint32_t shardCount, DensityImage& image);
+
+bool saveDensityShard(const std::string& path, const DensityImage& image);
+bool loadDensityShard(const std::string& path, DensityImage& image);
+
+// sums shard files into one image, failing unless they come from the same render and cover every shard once
+bool mergeDensityShards(const std::vector<std::string>& paths, DensityImage& merged);
+
+// 64-bit FNV-1a over the merged counts, equal hashes mean equal renders
+uint64_t densityHash(const DensityImage& image);
+
+// log scaled counts through each instance's gradient, instances add up; RGBA, width x height
+void toneMapDensity(const DensityImage& image, const Scene& scene, std::vector<sf::Uint8>& pixels);
+
+#endif
@@ -0,0 +1,72 @@
+#include "gradient.h"
+#include <algorithm>
+
+const char* colorModeName(ColorMode mode) {
+    switch (mode) {
+        case ColorMode::Amplitude: return "Amplitude";
+        case ColorMode::Speed: return "Speed";
+        case ColorMode::CentroidDistance: return "Centroid Distance";
+    }
+    return "";
+}
+
+ColorMode nextColorMode(ColorMode mode) {
+    switch (mode) {
+        case ColorMode::Amplitude: return ColorMode::Speed;
+        case ColorMode::Speed: return ColorMode::CentroidDistance;
+        case ColorMode::CentroidDistance: return ColorMode::Amplitude;
+    }
+    return ColorMode::Amplitude;
+}
+
+Gradient::Gradient(const sf::Color& startColor, const sf::Color& endColor, sf::Uint8 alpha) {
+    build({startColor, endColor}, alpha);
+}
+
+Gradient::Gradient(const std::vector<sf::Color>& stops, sf::Uint8 alpha) {
+    build(stops, alpha);
+}
+
+const GradientLUT& Gradient::lut() const {
+    return table;
+}
+
+const sf::Color& Gradient::operator[](uint8_t index) const {
+    return table[index];
+}
+
+void Gradient::build(const std::vector<sf::Color>& stops, sf::Uint8 alpha) {
+    if (stops.empty()) {
+        table.fill(sf::Color(255, 255, 255, alpha));
+        return;
+    }
+    if (stops.size() == 1) {
+        table.fill(sf::Color(stops[0].r, stops[0].g, stops[0].b, alpha));
+        return;
+    }
+
+    const size_t segments = stops.size() - 1;
+    for (size_t i = 0; i < table.size(); ++i) {
+        float t = static_cast<float>(i) / (table.size() - 1) * segments;
+        size_t segment = std::min(static_cast<size_t>(t), segments - 1);
+        float local = t - segment;
+        const sf::Color& start = stops[segment];
+        const sf::Color& end = stops[segment + 1];
+        table[i] = sf::Color(
+            static_cast<sf::Uint8>(start.r + local * (end.r - start.r)),
+            static_cast<sf::Uint8>(start.g + local * (end.g - start.g)),
+            static_cast<sf::Uint8>(start.b + local * (end.b - start.b)),
+            alpha
+        );
+    }
+}
+
+ColorScale::ColorScale() : range(0.0f) {}
+
+void ColorScale::update(float batchMax) {
+    range = std::max(range * 0.98f, batchMax);
+}
+
+float ColorScale::factor(float gain) const {
+    return range > 0.0f ? gain / range : 0.0f;
+}
@@ -0,0 +1,56 @@
+#ifndef GRADIENT_H
+#define GRADIENT_H
+
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <algorithm>
+#include <SFML/Graphics.hpp>
+
+typedef std::array<sf::Color, 256> GradientLUT;
+
+// what the per-particle gradient index is derived from
+enum class ColorMode {
+    Amplitude,        // global audio amplitude, every particle shares one color
+    Speed,            // local speed |dx/dt| of each particle
+    CentroidDistance  // distance of each particle from the centroid of the cloud
+};
+
+const char* colorModeName(ColorMode mode);
+ColorMode nextColorMode(ColorMode mode);
+
+// evenly spaced color stops baked into a 256 entry lookup table
+class Gradient {
+public:
+    Gradient(const sf::Color& startColor, const sf::Color& endColor, sf::Uint8 alpha = 160);
+    Gradient(const std::vector<sf::Color>& stops, sf::Uint8 alpha = 160);
+
+    const GradientLUT& lut() const;
+    const sf::Color& operator[](uint8_t index) const;
+
+private:
+    GradientLUT table;
+
+    void build(const std::vector<sf::Color>& stops, sf::Uint8 alpha);
+};
+
+// clamps t in [0, 1] onto a LUT index without branching
+inline uint8_t gradientIndex(float t) {
+    return static_cast<uint8_t>(std::min(t, 1.0f) * 255.0f);
+}
+
+// tracks the recent maximum of a non-negative per-particle scalar so it can be mapped onto the LUT
+class ColorScale {
+public:
+    ColorScale();
+
+    // widens to the batch maximum immediately and shrinks slowly so outliers fade out
+    void update(float batchMax);
+    // multiplier taking a scalar in the tracked range to [0, gain]
+    float factor(float gain) const;
+
+private:
+    float range;
+};
+
+#endif
@@ -0,0 +1,89 @@
+#include "jobs.h"
+#include <algorithm>
+#include "alloc_tracker.h"
+
+JobSystem::JobSystem(unsigned threadCount)
+    : generation(0), pending(0), stopping(false), jobFn(nullptr), jobContext(nullptr), jobCount(0)
+{
+    unsigned workerCount = std::max(threadCount, 1u) - 1;
+    for (unsigned i = 0; i < workerCount; ++i) {
+        workers.emplace_back(&JobSystem::workerLoop, this, i + 1);
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+unsigned JobSystem::size() const {
+    return static_cast<unsigned>(workers.size()) + 1;
+}
+
+void JobSystem::runChunk(unsigned chunk) {
+    size_t chunks = size();
+    size_t begin = jobCount * chunk / chunks;
+    size_t end = jobCount * (chunk + 1) / chunks;
+    if (begin < end) {
+        jobFn(jobContext, chunk, begin, end);
+    }
+}
+
+void JobSystem::dispatch(size_t count, JobFn fn, void* context) {
+    if (count == 0) {
+        return;
+    }
+    // small loops are not worth waking the workers for
+    if (workers.empty() || count < 2 * size()) {
+        fn(context, 0, 0, count);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobFn = fn;
+        jobContext = context;
+        jobCount = count;
+        pending = static_cast<unsigned>(workers.size());
+        ++generation;
+    }
+    wake.notify_all();
+
+    runChunk(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return pending == 0; });
+}
+
+void JobSystem::workerLoop(unsigned worker) {
+    // workers run frame stages on behalf of the calling thread
+    trackAllocationsOnThisThread();
+    unsigned seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+        }
+
+        runChunk(worker);
+
+        bool last;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            last = --pending == 0;
+        }
+        if (last) {
+            done.notify_one();
+        }
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+// persistent worker threads for data parallel loops, shared by every pipeline stage
+class JobSystem {
+public:
+    explicit JobSystem(unsigned threadCount = std::thread::hardware_concurrency());
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // number of chunks a parallelFor is split into (workers plus the calling thread)
+    unsigned size() const;
+
+    // calls fn(chunk, begin, end) for contiguous slices of [0, count) and blocks until all are done
+    // the callable is passed by pointer, so dispatching a job never allocates
+    template <typename Fn>
+    void parallelFor(size_t count, Fn&& fn) {
+        typedef typename std::remove_reference<Fn>::type FnType;
+        dispatch(count, &invoke<FnType>, const_cast<void*>(static_cast<const void*>(&fn)));
+    }
+
+private:
+    typedef void (*JobFn)(void* context, size_t chunk, size_t begin, size_t end);
+
+    template <typename Fn>
+    static void invoke(void* context, size_t chunk, size_t begin, size_t end) {
+        (*static_cast<Fn*>(context))(chunk, begin, end);
+    }
+
+    void dispatch(size_t count, JobFn fn, void* context);
+    void workerLoop(unsigned worker);
+    void runChunk(unsigned chunk);
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    unsigned generation;
+    unsigned pending;
+    bool stopping;
+
+    JobFn jobFn;
+    void* jobContext;
+    size_t jobCount;
+};
+
+#endif
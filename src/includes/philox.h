@@ -0,0 +1,39 @@
+#ifndef PHILOX_H
+#define PHILOX_H
+
+#include <array>
+#include <cstdint>
+
+// counter-based random numbers, Philox4x32-10 from Salmon et al., "Parallel random numbers: as easy as 1, 2, 3"
+//
+// there is no generator state: every output block is a pure function of a key and a counter, so any value can be
+// computed on its own, in any order and on any thread or process, and always comes out the same
+
+typedef std::array<uint32_t, 4> PhiloxCounter;
+typedef std::array<uint32_t, 2> PhiloxKey;
+
+// four random 32-bit words for a counter under a key
+inline PhiloxCounter philox(PhiloxCounter counter, PhiloxKey key) {
+    const uint32_t M0 = 0xD2511F53, M1 = 0xCD9E8D57;
+    const uint32_t W0 = 0x9E3779B9, W1 = 0xBB67AE85;
+    for (int round = 0; round < 10; ++round) {
+        uint64_t product0 = static_cast<uint64_t>(M0) * counter[0];
+        uint64_t product1 = static_cast<uint64_t>(M1) * counter[2];
+        counter = {
+            static_cast<uint32_t>(product1 >> 32) ^ counter[1] ^ key[0],
+            static_cast<uint32_t>(product1),
+            static_cast<uint32_t>(product0 >> 32) ^ counter[3] ^ key[1],
+            static_cast<uint32_t>(product0)
+        };
+        key[0] += W0;
+        key[1] += W1;
+    }
+    return counter;
+}
+
+// uniform in [0, 1) from the top 24 bits, which a float holds exactly
+inline float unitFloat(uint32_t bits) {
+    return static_cast<float>(bits >> 8) * (1.0f / 16777216.0f);
+}
+
+#endif
@@ -0,0 +1,123 @@
+#include "publisher.h"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <new>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// readers get this many frames to finish with a slot before it is written again
+static const uint32_t SLOT_COUNT = 4;
+
+SharedStatePublisher::SharedStatePublisher() : header(nullptr), mappedSize(0), frameNumber(0) {}
+
+SharedStatePublisher::~SharedStatePublisher() {
+    close();
+}
+
+bool SharedStatePublisher::open(const Scene& scene, const std::string& name) {
+    // room for the particle counts to double, Aizawa keeps spawning
+    size_t particles = 0;
+    for (const auto& instance : scene.instances()) {
+        particles += std::max(instance.particleCount, instance.points.size());
+    }
+    uint32_t maxParticles = static_cast<uint32_t>(std::max<size_t>(particles * 2, 4096));
+    size_t slotSize = sharedSlotSize(maxParticles);
+    size_t size = SHARED_STATE_HEADER_SIZE + SLOT_COUNT * slotSize;
+
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        std::cerr << "Error creating shared memory " << name << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+    if (ftruncate(fd, size) != 0) {
+        std::cerr << "Error sizing shared memory " << name << ": " << std::strerror(errno) << std::endl;
+        ::close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+    void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Error mapping shared memory " << name << ": " << std::strerror(errno) << std::endl;
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    header = new (mapping) SharedStateHeader();
+    header->version = SHARED_STATE_VERSION;
+    header->slotCount = SLOT_COUNT;
+    header->maxParticles = maxParticles;
+    header->slotSize = slotSize;
+    header->latest.store(0, std::memory_order_relaxed);
+    header->closed.store(0, std::memory_order_relaxed);
+    for (uint32_t slot = 0; slot < SLOT_COUNT; ++slot) {
+        SharedFrameHeader* frame = new (sharedSlot(header, slot)) SharedFrameHeader();
+        frame->sequence.store(0, std::memory_order_relaxed);
+    }
+    // readers check the magic first, so it goes in last
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = SHARED_STATE_MAGIC;
+
+    this->name = name;
+    mappedSize = size;
+    frameNumber = 0;
+    return true;
+}
+
+bool SharedStatePublisher::isOpen() const {
+    return header != nullptr;
+}
+
+void SharedStatePublisher::publish(const Scene& scene, const AudioLevels& levels, float screenWidth, float screenHeight) {
+    SharedFrameHeader* slot = sharedSlot(header, static_cast<uint32_t>(frameNumber % header->slotCount));
+    uint64_t sequence = slot->sequence.load(std::memory_order_relaxed);
+    slot->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    float* positions = reinterpret_cast<float*>(slot + 1);
+    float* projected = positions + static_cast<size_t>(header->maxParticles) * 3;
+    slot->frame = frameNumber;
+    std::copy(levels.bands.begin(), levels.bands.end(), slot->audio);
+    slot->screenWidth = screenWidth;
+    slot->screenHeight = screenHeight;
+
+    uint32_t particles = 0;
+    uint32_t instanceCount = 0;
+    for (const auto& instance : scene.instances()) {
+        if (instanceCount == SHARED_STATE_MAX_INSTANCES) {
+            break;
+        }
+        uint32_t count = static_cast<uint32_t>(std::min(instance.points.size(), instance.screenPositions.size()));
+        count = std::min(count, header->maxParticles - particles);
+        SharedInstance& shared = slot->instances[instanceCount++];
+        std::strncpy(shared.attractor, instance.name.c_str(), sizeof(shared.attractor) - 1);
+        shared.attractor[sizeof(shared.attractor) - 1] = '\0';
+        shared.first = particles;
+        shared.count = count;
+        if (count > 0) {
+            std::memcpy(positions + particles * 3, instance.points.data(), count * 3 * sizeof(float));
+            std::memcpy(projected + particles * 2, instance.screenPositions.data(), count * 2 * sizeof(float));
+        }
+        particles += count;
+    }
+    slot->instanceCount = instanceCount;
+    slot->particleCount = particles;
+
+    slot->sequence.store(sequence + 2, std::memory_order_release);
+    header->latest.store(++frameNumber, std::memory_order_release);
+}
+
+void SharedStatePublisher::close() {
+    if (!header) {
+        return;
+    }
+    header->closed.store(1, std::memory_order_release);
+    munmap(header, mappedSize);
+    shm_unlink(name.c_str());
+    header = nullptr;
+    mappedSize = 0;
+}
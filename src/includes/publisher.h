@@ -0,0 +1,32 @@
+#ifndef PUBLISHER_H
+#define PUBLISHER_H
+
+#include <string>
+#include "shared_state.h"
+#include "scene.h"
+
+// writes every frame's particle state into the shared memory ring described in shared_state.h
+class SharedStatePublisher {
+public:
+    SharedStatePublisher();
+    ~SharedStatePublisher();
+
+    SharedStatePublisher(const SharedStatePublisher&) = delete;
+    SharedStatePublisher& operator=(const SharedStatePublisher&) = delete;
+
+    // creates the segment, replacing one left behind by a previous run, reporting problems on std::cerr
+    bool open(const Scene& scene, const std::string& name = SHARED_STATE_NAME);
+    bool isOpen() const;
+    // particles beyond the capacity the segment was created with are left out
+    void publish(const Scene& scene, const AudioLevels& levels, float screenWidth, float screenHeight);
+    // marks the segment closed for readers and removes its name
+    void close();
+
+private:
+    std::string name;
+    SharedStateHeader* header;
+    size_t mappedSize;
+    uint64_t frameNumber;
+};
+
+#endif
@@ -0,0 +1,62 @@
+#include "radix_sort.h"
+#include <algorithm>
+
+RadixSorter::RadixSorter(JobSystem& jobs) : jobs(jobs) {}
+
+void RadixSorter::reserve(size_t count) {
+    order.reserve(count);
+    scratch.reserve(count);
+    keyScratch[0].reserve(count);
+    keyScratch[1].reserve(count);
+}
+
+const std::vector<uint32_t>& RadixSorter::sort(const uint16_t* keys, size_t count) {
+    order.resize(count);
+    scratch.resize(count);
+    keyScratch[0].resize(count);
+    keyScratch[1].resize(count);
+    histograms.resize(jobs.size() * 256);
+
+    jobs.parallelFor(count, [&](size_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            scratch[i] = static_cast<uint32_t>(i);
+        }
+    });
+
+    pass(keys, scratch.data(), keyScratch[0].data(), order.data(), count, 0);
+    pass(keyScratch[0].data(), order.data(), keyScratch[1].data(), scratch.data(), count, 8);
+    order.swap(scratch);
+    return order;
+}
+
+void RadixSorter::pass(const uint16_t* keysIn, const uint32_t* valuesIn, uint16_t* keysOut, uint32_t* valuesOut, size_t count, int shift) {
+    const size_t chunks = jobs.size();
+    std::fill(histograms.begin(), histograms.end(), 0);
+
+    // every chunk counts its own digits
+    jobs.parallelFor(count, [&](size_t chunk, size_t begin, size_t end) {
+        size_t* histogram = &histograms[chunk * 256];
+        for (size_t i = begin; i < end; ++i) {
+            ++histogram[(keysIn[i] >> shift) & 0xFF];
+        }
+    });
+
+    // exclusive prefix sum in (digit, chunk) order gives every chunk its own write cursor per digit, which keeps the sort stable
+    size_t offset = 0;
+    for (size_t digit = 0; digit < 256; ++digit) {
+        for (size_t chunk = 0; chunk < chunks; ++chunk) {
+            size_t bucket = histograms[chunk * 256 + digit];
+            histograms[chunk * 256 + digit] = offset;
+            offset += bucket;
+        }
+    }
+
+    jobs.parallelFor(count, [&](size_t chunk, size_t begin, size_t end) {
+        size_t* cursor = &histograms[chunk * 256];
+        for (size_t i = begin; i < end; ++i) {
+            size_t dst = cursor[(keysIn[i] >> shift) & 0xFF]++;
+            keysOut[dst] = keysIn[i];
+            valuesOut[dst] = valuesIn[i];
+        }
+    });
+}
@@ -0,0 +1,29 @@
+#ifndef RADIX_SORT_H
+#define RADIX_SORT_H
+
+#include <vector>
+#include <cstdint>
+#include "jobs.h"
+
+// stable LSD radix sort of 16-bit keys, two 8-bit passes each split across the job system
+// scratch buffers are kept between calls so sorting every frame does not reallocate
+class RadixSorter {
+public:
+    explicit RadixSorter(JobSystem& jobs);
+
+    void reserve(size_t count);
+
+    // returns the indices [0, count) ordered by ascending key
+    const std::vector<uint32_t>& sort(const uint16_t* keys, size_t count);
+
+private:
+    JobSystem& jobs;
+    std::vector<uint32_t> order;
+    std::vector<uint32_t> scratch;
+    std::vector<uint16_t> keyScratch[2];
+    std::vector<size_t> histograms; // 256 buckets per chunk
+
+    void pass(const uint16_t* keysIn, const uint32_t* valuesIn, uint16_t* keysOut, uint32_t* valuesOut, size_t count, int shift);
+};
+
+#endif
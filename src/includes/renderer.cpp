@@ -0,0 +1,46 @@
+#include "renderer.h"
+
+SfmlRenderer::SfmlRenderer()
+    : trailBuffer(sf::PrimitiveType::Lines, sf::VertexBuffer::Stream),
+      pointBuffer(sf::PrimitiveType::Quads, sf::VertexBuffer::Stream),
+      uploadedBatch(nullptr), uploadedVersion(0) {}
+
+void SfmlRenderer::upload(sf::VertexBuffer& buffer, const std::vector<sf::Vertex>& vertices) {
+    if (vertices.empty()) {
+        return;
+    }
+    // grown with headroom like the batch itself, so a slowly growing scene doesn't recreate it every frame
+    if (buffer.getVertexCount() < vertices.size()) {
+        buffer.create(vertices.size() * 3 / 2);
+    }
+    buffer.update(vertices.data(), vertices.size(), 0);
+}
+
+void SfmlRenderer::draw(sf::RenderTarget& target, const DrawBatch& batch, bool additive) {
+    // additive blending is order independent, alpha blending is drawn back to front
+    sf::RenderStates states(additive ? sf::BlendAdd : sf::BlendAlpha);
+
+    if (!sf::VertexBuffer::isAvailable()) {
+        // every instance shares the same two vertex arrays, so the whole scene is one lines and one quads draw
+        if (!batch.trailVertices.empty()) {
+            target.draw(batch.trailVertices.data(), batch.trailVertices.size(), sf::PrimitiveType::Lines, states);
+        }
+        if (!batch.pointVertices.empty()) {
+            target.draw(batch.pointVertices.data(), batch.pointVertices.size(), sf::PrimitiveType::Quads, states);
+        }
+        return;
+    }
+
+    if (uploadedBatch != &batch || uploadedVersion != batch.version()) {
+        upload(trailBuffer, batch.trailVertices);
+        upload(pointBuffer, batch.pointVertices);
+        uploadedBatch = &batch;
+        uploadedVersion = batch.version();
+    }
+    if (!batch.trailVertices.empty()) {
+        target.draw(trailBuffer, 0, batch.trailVertices.size(), states);
+    }
+    if (!batch.pointVertices.empty()) {
+        target.draw(pointBuffer, 0, batch.pointVertices.size(), states);
+    }
+}
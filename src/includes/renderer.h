@@ -0,0 +1,33 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <SFML/Graphics.hpp>
+#include "batch.h"
+
+// draws a scene's batch into a target that the caller has cleared and will display
+class Renderer {
+public:
+    virtual ~Renderer() {}
+
+    virtual void draw(sf::RenderTarget& target, const DrawBatch& batch, bool additive) = 0;
+};
+
+// hands the batch to SFML as one lines and one quads draw
+// the vertices go through GPU vertex buffers that are only refilled when the batch changed, so a paused scene
+// costs two draw calls; without vertex buffer support they are drawn straight from the batch every frame
+class SfmlRenderer : public Renderer {
+public:
+    SfmlRenderer();
+
+    void draw(sf::RenderTarget& target, const DrawBatch& batch, bool additive) override;
+
+private:
+    sf::VertexBuffer trailBuffer;
+    sf::VertexBuffer pointBuffer;
+    const DrawBatch* uploadedBatch;
+    uint64_t uploadedVersion;
+
+    static void upload(sf::VertexBuffer& buffer, const std::vector<sf::Vertex>& vertices);
+};
+
+#endif
@@ -0,0 +1,471 @@
+#include "scene.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <limits>
+#include <cmath>
+#include <algorithm>
+#include "attractors/attractors.h"
+#include "alloc_tracker.h"
+#include "philox.h"
+
+// particles stepped per call into the attractor's kernel
+static const size_t STEP_BLOCK = 64;
+// beyond this a scene's particle budget is a typo, the trails alone would take gigabytes
+static const long long MAX_INSTANCE_PARTICLES = 1000000;
+// spawning grows and trims the particle arrays in blocks, only those steps may allocate
+static const char* const RESPAWN_GROWTH = "respawn growth";
+
+bool parseAudioBand(const std::string& name, AudioBand& band) {
+    if (name == "full") {
+        band = AudioBand::Full;
+    } else if (name == "low") {
+        band = AudioBand::Low;
+    } else if (name == "mid") {
+        band = AudioBand::Mid;
+    } else if (name == "high") {
+        band = AudioBand::High;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool parseColor(const std::string& text, sf::Color& color) {
+    int r, g, b;
+    char comma1, comma2;
+    std::istringstream stream(text);
+    if (!(stream >> r >> comma1 >> g >> comma2 >> b) || comma1 != ',' || comma2 != ',' ||
+        r < 0 || r > 255 || g < 0 || g > 255 || b < 0 || b > 255) {
+        return false;
+    }
+    color = sf::Color(static_cast<sf::Uint8>(r), static_cast<sf::Uint8>(g), static_cast<sf::Uint8>(b));
+    return true;
+}
+
+bool loadScene(const std::string& path, SceneConfig& scene) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Error opening scene " << path << std::endl;
+        return false;
+    }
+
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        ++lineNumber;
+        std::istringstream stream(line);
+        std::string key;
+        if (!(stream >> key) || key[0] == '#') {
+            continue;
+        }
+
+        bool ok = true;
+        InstanceConfig* instance = scene.instances.empty() ? nullptr : &scene.instances.back();
+        if (key == "audio") {
+            std::getline(stream >> std::ws, scene.audio);
+            ok = !scene.audio.empty();
+        } else if (key == "fov") {
+            float degrees = 0.0f;
+            ok = stream >> degrees && degrees >= 10.0f && degrees <= 150.0f;
+            scene.fov = degrees * static_cast<float>(M_PI) / 180.0f;
+        } else if (key == "distance") {
+            ok = stream >> scene.eyeDistance && scene.eyeDistance >= 0.25f && scene.eyeDistance <= 10.0f;
+        } else if (key == "attractor") {
+            InstanceConfig config;
+            ok = static_cast<bool>(stream >> config.attractor) && makeAttractor(config.attractor) != nullptr;
+            scene.instances.push_back(config);
+        } else if (!instance) {
+            ok = false;
+        } else if (key == "offset") {
+            ok = static_cast<bool>(stream >> instance->offsetX >> instance->offsetY);
+            instance->hasOffset = true;
+        } else if (key == "scale") {
+            ok = static_cast<bool>(stream >> instance->scale);
+            instance->hasScale = true;
+        } else if (key == "rotation") {
+            ok = static_cast<bool>(stream >> instance->rotation[0] >> instance->rotation[1] >> instance->rotation[2]);
+            instance->hasRotation = true;
+        } else if (key == "particles") {
+            long long particles = 0;
+            ok = stream >> particles && particles > 0 && particles <= MAX_INSTANCE_PARTICLES;
+            instance->particles = ok ? static_cast<size_t>(particles) : 0;
+        } else if (key == "trail") {
+            std::string length;
+            ok = stream >> length && parseTrailLength(length, instance->trail);
+        } else if (key == "sampling") {
+            float spacing = 0.0f, degrees = 0.0f;
+            ok = stream >> spacing >> degrees && spacing > 0.0f && degrees >= 0.0f;
+            if (ok) {
+                instance->sampling.spacing = spacing;
+                instance->sampling.turn = degrees * static_cast<float>(M_PI) / 180.0f;
+            }
+        } else if (key == "gradient") {
+            std::string stop;
+            while (ok && stream >> stop) {
+                sf::Color color;
+                ok = parseColor(stop, color);
+                instance->gradient.push_back(color);
+            }
+        } else if (key == "band") {
+            std::string band;
+            ok = stream >> band && parseAudioBand(band, instance->band);
+        } else if (key == "amplitude") {
+            ok = static_cast<bool>(stream >> instance->maxAmplitude);
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            std::cerr << path << ":" << lineNumber << ": invalid line: " << line << std::endl;
+            return false;
+        }
+    }
+
+    if (scene.instances.empty()) {
+        std::cerr << path << ": scene has no attractors" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static TrailLength defaultTrailLength(const Attractor& attractor) {
+    TrailLength length;
+    length.value = static_cast<float>(attractor.trailsize);
+    return length;
+}
+
+AttractorInstance::AttractorInstance(std::unique_ptr<Attractor> attractor, const InstanceConfig& config)
+    : name(config.attractor),
+      attractor(std::move(attractor)),
+      scale(config.hasScale ? config.scale : this->attractor->scale),
+      offsetX(config.hasOffset ? config.offsetX : this->attractor->offsetX),
+      offsetY(config.hasOffset ? config.offsetY : this->attractor->offsetY),
+      rotation(config.hasRotation ? config.rotation : this->attractor->angles[0]),
+      particleCount(config.particles ? config.particles : this->attractor->particlecount),
+      band(config.band),
+      precision(this->attractor->precision()),
+      maxAmplitude(config.maxAmplitude > 0.0f ? config.maxAmplitude : this->attractor->maxamplitude),
+      trailAlpha(dynamic_cast<const ThomasAttractor*>(this->attractor.get()) ? 100.0f : 70.0f),
+      gradient(!config.gradient.empty() ? config.gradient
+               : !this->attractor->gradientStops.empty() ? this->attractor->gradientStops
+               : std::vector<sf::Color>{this->attractor->startColor, this->attractor->endColor}),
+      respawnCounter(0), spawnGeneration(0),
+      trails(config.trail.value > 0.0f ? config.trail : defaultTrailLength(*this->attractor), config.sampling)
+{
+    stepper = makeAttractor(*this->attractor, this->attractor->defdt);
+}
+
+void AttractorInstance::reserve(size_t count) {
+    points.reserve(count);
+    if (precision == Precision::Mixed) {
+        precisePoints.reserve(count);
+    }
+    trails.reserve(count);
+    screenPositions.reserve(count);
+    depths.reserve(count);
+    depthKeys.reserve(count);
+    colorValues.reserve(count);
+    colorIndices.reserve(count);
+}
+
+void AttractorInstance::addPoint(const std::array<float, 3>& point) {
+    points.push_back(point);
+    if (precision == Precision::Mixed) {
+        precisePoints.push_back({point[0], point[1], point[2]});
+    }
+}
+
+float AttractorInstance::normalizedAmplitude(const AudioLevels& levels) const {
+    return std::min(levels[band] / maxAmplitude, 1.0f);
+}
+
+Scene::Scene(JobSystem& jobs)
+    : colorMode(ColorMode::Amplitude), projection(Projection::Orthographic), fov(0.7f), eyeDistance(1.0f), jobs(jobs),
+      seed(0), hasLastInputs(false), skipped(false),
+      chunkMax(jobs.size()), chunkMinDepth(jobs.size()), chunkMaxDepth(jobs.size())
+{
+}
+
+void Scene::addInstance(std::unique_ptr<Attractor> attractor, const InstanceConfig& config) {
+    sceneInstances.emplace_back(std::move(attractor), config);
+}
+
+std::vector<AttractorInstance>& Scene::instances() {
+    return sceneInstances;
+}
+
+const std::vector<AttractorInstance>& Scene::instances() const {
+    return sceneInstances;
+}
+
+// a spawned particle's position, uniform in [-range, range) on every axis; a pure function of the seed, the
+// instance, the particle's index and the generation it was spawned in, so any particle can be seeded on its own
+static std::array<float, 3> spawnPoint(uint32_t seed, size_t instance, size_t particle, uint32_t generation, float range) {
+    PhiloxCounter bits = philox({static_cast<uint32_t>(particle), static_cast<uint32_t>(static_cast<uint64_t>(particle) >> 32),
+                                 generation, static_cast<uint32_t>(instance)},
+                                {seed, 0});
+    return {
+        (2.0f * unitFloat(bits[0]) - 1.0f) * range,
+        (2.0f * unitFloat(bits[1]) - 1.0f) * range,
+        (2.0f * unitFloat(bits[2]) - 1.0f) * range
+    };
+}
+
+void Scene::initializePoints(unsigned seed) {
+    this->seed = seed;
+    hasLastInputs = false;
+
+    for (size_t index = 0; index < sceneInstances.size(); ++index) {
+        AttractorInstance& instance = sceneInstances[index];
+        const float randrange = instance.attractor->randrange;
+        const size_t count = instance.particleCount;
+        // two clusters on either side of the origin, one per wing
+        const bool wings = dynamic_cast<const LorenzAttractor*>(instance.attractor.get()) != nullptr;
+        const bool mixed = instance.precision == Precision::Mixed;
+        instance.spawnGeneration = 0;
+        instance.points.resize(count);
+        instance.precisePoints.resize(mixed ? count : 0);
+
+        // every particle is seeded on its own, so the chunking doesn't change the result
+        jobs.parallelFor(count, [&](size_t, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                std::array<float, 3> point = spawnPoint(this->seed, index, i, 0, randrange);
+                if (wings) {
+                    point[0] = ((i < count / 2) ? -0.1f : 0.1f) + point[0] * 0.01f;
+                }
+                instance.points[i] = point;
+                if (mixed) {
+                    instance.precisePoints[i] = {point[0], point[1], point[2]};
+                }
+            }
+        });
+        instance.trails.resize(count);
+    }
+}
+
+void Scene::resetTransforms() {
+    hasLastInputs = false;
+    for (auto& instance : sceneInstances) {
+        instance.rotation = instance.attractor->angles[0];
+    }
+}
+
+void Scene::respawn(AttractorInstance& instance) {
+    std::vector<std::array<float, 3>>& points = instance.points;
+    const float randrange = instance.attractor->randrange;
+    const size_t REALLOC_THRESHOLD = 1000; // threshold for reallocation
+    const size_t REALLOC_INCREASE = 500;   // number of new elements to add during reallocation
+    instance.respawnCounter = (instance.respawnCounter + 1) % 40;
+    if(instance.respawnCounter%40 == 0){
+        // each wave of spawns is a new generation of particles
+        ++instance.spawnGeneration;
+        const size_t index = &instance - sceneInstances.data();
+
+        // check if we need to reallocate
+        if (points.size() + 10 > points.capacity()) {
+            AllocationStage stage(RESPAWN_GROWTH, true);
+            size_t newCapacity = points.capacity() + REALLOC_INCREASE;
+            instance.reserve(newCapacity);
+        }
+        for (int i = 0; i < 10; ++i) {
+            instance.addPoint(spawnPoint(seed, index, points.size(), instance.spawnGeneration, 10 * randrange));
+        }
+        instance.trails.resize(points.size());
+    }
+
+    // periodically remove excess capacity to save memory
+    if (points.size() > REALLOC_THRESHOLD && points.capacity() - points.size() > REALLOC_INCREASE) {
+        AllocationStage stage(RESPAWN_GROWTH, true);
+        std::vector<std::array<float, 3>> temp_points(points.begin(), points.end());
+        points.swap(temp_points); // swap points with temp_points which has no extra memory allocation
+        std::vector<std::array<double, 3>>(instance.precisePoints.begin(), instance.precisePoints.end()).swap(instance.precisePoints);
+
+        instance.trails.shrinkToFit();
+    }
+}
+
+static bool sameView(const ViewState& a, const ViewState& b) {
+    return a.rotationX == b.rotationX && a.rotationY == b.rotationY && a.zoom == b.zoom &&
+           a.offsetX == b.offsetX && a.offsetY == b.offsetY;
+}
+
+bool Scene::unchanged() const {
+    return skipped;
+}
+
+const DepthRange& Scene::depthRange() const {
+    return sceneDepthRange;
+}
+
+void Scene::update(const AudioLevels& levels, bool paused, const ViewState& view, float screenWidth, float screenHeight, float frameTime) {
+    // while paused particles only move on screen through the view, so the same inputs give the same frame
+    skipped = paused && hasLastInputs && lastInputs.levels.bands == levels.bands && sameView(lastInputs.view, view) &&
+              lastInputs.screenWidth == screenWidth && lastInputs.screenHeight == screenHeight &&
+              lastInputs.colorMode == colorMode && lastInputs.projection == projection && lastInputs.fov == fov &&
+              lastInputs.eyeDistance == eyeDistance;
+    if (skipped) {
+        return;
+    }
+    lastInputs.levels = levels;
+    lastInputs.view = view;
+    lastInputs.screenWidth = screenWidth;
+    lastInputs.screenHeight = screenHeight;
+    lastInputs.colorMode = colorMode;
+    lastInputs.projection = projection;
+    lastInputs.fov = fov;
+    lastInputs.eyeDistance = eyeDistance;
+    hasLastInputs = true;
+
+    float minDepth = std::numeric_limits<float>::max();
+    float maxDepth = std::numeric_limits<float>::lowest();
+
+    for (auto& instance : sceneInstances) {
+        float amplitude = std::min(levels[instance.band], 800.0f);
+        const Attractor& attractor = *instance.attractor;
+        instance.stepper->dt = paused ? 0.0f : std::min(attractor.speedfactor(attractor.defdt, amplitude), attractor.maxdt);
+
+        // pausing freezes the whole simulation, spawning and the automatic rotation included
+        if (!paused && dynamic_cast<const AizawaAttractor*>(&attractor)) {
+            respawn(instance);
+        }
+        if(!paused && dynamic_cast<const SprottAttractor*>(&attractor)){
+            instance.rotation[0] += 0.0003f;
+            instance.rotation[1] += 0.0001f;
+        }
+
+        instance.camera.projection = projection;
+        instance.camera.fov = fov;
+        instance.camera.eyeDistance = eyeDistance;
+        instance.camera.update(instance.rotation[0] + view.rotationX, instance.rotation[1] + view.rotationY, instance.rotation[2],
+                               instance.scale * view.zoom, screenWidth, screenHeight,
+                               instance.offsetX + view.offsetX, instance.offsetY + view.offsetY);
+
+        simulate(instance, levels, paused, minDepth, maxDepth);
+    }
+
+    // one depth range for the whole scene so instances sort against each other
+    sceneDepthRange.update(minDepth, maxDepth);
+    for (auto& instance : sceneInstances) {
+        instance.trails.setScreen(screenWidth, screenHeight);
+        instance.trails.setDepthOrigin(instance.camera.centreDepth());
+        if (!paused) {
+            instance.trails.tick(frameTime);
+        }
+        jobs.parallelFor(instance.points.size(), [&](size_t, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                instance.depthKeys[i] = sceneDepthRange.key(instance.depths[i]);
+                instance.trails.push(i, instance.screenPositions[i].x, instance.screenPositions[i].y, instance.colorIndices[i], instance.depths[i]);
+            }
+        });
+    }
+}
+
+void Scene::simulate(AttractorInstance& instance, const AudioLevels& levels, bool paused, float& minDepth, float& maxDepth) {
+    std::vector<std::array<float, 3>>& points = instance.points;
+    const Attractor& stepper = *instance.stepper;
+    const Camera& camera = instance.camera;
+
+    if (instance.screenPositions.capacity() < points.size()) {
+        AllocationStage stage("particle growth", true);
+        instance.reserve(points.capacity());
+    }
+    instance.screenPositions.resize(points.size());
+    instance.depths.resize(points.size());
+    instance.depthKeys.resize(points.size());
+    instance.colorValues.resize(points.size());
+    instance.colorIndices.resize(points.size());
+
+    // speed mode measures the step against the previous position and divides by the step's dt, so louder music
+    // (a longer step) doesn't change a particle's color; centroid mode measures against the centroid of the cloud
+    const bool speedColoring = colorMode == ColorMode::Speed;
+    const bool mixed = instance.precision == Precision::Mixed;
+    const float inverseDt = stepper.dt > 0.0f ? 1.0f / stepper.dt : 0.0f;
+    std::array<float, 3> centroid = {0.0f, 0.0f, 0.0f};
+    if (colorMode == ColorMode::CentroidDistance && !points.empty()) {
+        for (const auto& p : points) {
+            centroid[0] += p[0];
+            centroid[1] += p[1];
+            centroid[2] += p[2];
+        }
+        for (float& c : centroid) {
+            c /= points.size();
+        }
+    }
+
+    std::fill(chunkMax.begin(), chunkMax.end(), 0.0f);
+    std::fill(chunkMinDepth.begin(), chunkMinDepth.end(), std::numeric_limits<float>::max());
+    std::fill(chunkMaxDepth.begin(), chunkMaxDepth.end(), std::numeric_limits<float>::lowest());
+
+    jobs.parallelFor(points.size(), [&](size_t chunk, size_t begin, size_t end) {
+        float batchMax = 0.0f;
+        float batchMinDepth = std::numeric_limits<float>::max();
+        float batchMaxDepth = std::numeric_limits<float>::lowest();
+        // the attractor's kernel steps a block at a time, the block's previous positions stay on the stack for speed coloring
+        // with mixed precision a step is too small for the float copies to resolve, so it is measured in double
+        std::array<std::array<float, 3>, STEP_BLOCK> previous;
+        std::array<std::array<double, 3>, STEP_BLOCK> previousPrecise;
+        for (size_t blockBegin = begin; blockBegin < end; blockBegin += STEP_BLOCK) {
+            size_t blockSize = std::min(end - blockBegin, STEP_BLOCK);
+            if (speedColoring && mixed) {
+                std::copy(&instance.precisePoints[blockBegin], &instance.precisePoints[blockBegin] + blockSize, previousPrecise.begin());
+            } else if (speedColoring) {
+                std::copy(&points[blockBegin], &points[blockBegin] + blockSize, previous.begin());
+            }
+            if (mixed) {
+                std::array<double, 3>* precise = &instance.precisePoints[blockBegin];
+                stepper.advance(precise, blockSize);
+                for (size_t i = 0; i < blockSize; ++i) {
+                    points[blockBegin + i] = {static_cast<float>(precise[i][0]), static_cast<float>(precise[i][1]), static_cast<float>(precise[i][2])};
+                }
+            } else {
+                stepper.advance(&points[blockBegin], blockSize);
+            }
+
+            for (size_t i = blockBegin; i < blockBegin + blockSize; ++i) {
+                if (speedColoring && mixed) {
+                    const std::array<double, 3>& point = instance.precisePoints[i];
+                    const std::array<double, 3>& reference = previousPrecise[i - blockBegin];
+                    double dx = point[0] - reference[0];
+                    double dy = point[1] - reference[1];
+                    double dz = point[2] - reference[2];
+                    instance.colorValues[i] = static_cast<float>(std::sqrt(dx * dx + dy * dy + dz * dz)) * inverseDt;
+                } else {
+                    const std::array<float, 3>& reference = speedColoring ? previous[i - blockBegin] : centroid;
+                    float dx = points[i][0] - reference[0];
+                    float dy = points[i][1] - reference[1];
+                    float dz = points[i][2] - reference[2];
+                    instance.colorValues[i] = std::sqrt(dx * dx + dy * dy + dz * dz) * (speedColoring ? inverseDt : 1.0f);
+                }
+                batchMax = std::max(batchMax, instance.colorValues[i]);
+
+                // culled points keep a NaN screen position, they are left out of the depth range and never drawn
+                float screenX, screenY;
+                if (camera.project(points[i][0], points[i][1], points[i][2], screenX, screenY, instance.depths[i])) {
+                    batchMinDepth = std::min(batchMinDepth, instance.depths[i]);
+                    batchMaxDepth = std::max(batchMaxDepth, instance.depths[i]);
+                }
+                instance.screenPositions[i] = sf::Vector2f(screenX, screenY);
+            }
+        }
+        chunkMax[chunk] = batchMax;
+        chunkMinDepth[chunk] = batchMinDepth;
+        chunkMaxDepth[chunk] = batchMaxDepth;
+    });
+
+    float batchMax = *std::max_element(chunkMax.begin(), chunkMax.end());
+    minDepth = std::min(minDepth, *std::min_element(chunkMinDepth.begin(), chunkMinDepth.end()));
+    maxDepth = std::max(maxDepth, *std::max_element(chunkMaxDepth.begin(), chunkMaxDepth.end()));
+
+    // coloring pass: one LUT index per particle, kept as-is while paused so speed coloring does not fade to zero
+    float normalizedAmplitude = instance.normalizedAmplitude(levels);
+    if (colorMode == ColorMode::Amplitude) {
+        std::fill(instance.colorIndices.begin(), instance.colorIndices.end(), gradientIndex(normalizedAmplitude));
+    } else if (!paused) {
+        instance.colorScale.update(batchMax);
+        float factor = instance.colorScale.factor(0.75f + 0.5f * normalizedAmplitude);
+        for (size_t i = 0; i < points.size(); ++i) {
+            instance.colorIndices[i] = gradientIndex(instance.colorValues[i] * factor);
+        }
+    }
+}
@@ -0,0 +1,161 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <vector>
+#include <array>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <SFML/Graphics.hpp>
+#include "attractors/base_attractor.h"
+#include "gradient.h"
+#include "trail.h"
+#include "camera.h"
+#include "jobs.h"
+
+enum class AudioBand {
+    Full,
+    Low,
+    Mid,
+    High
+};
+
+bool parseAudioBand(const std::string& name, AudioBand& band);
+
+// per-frame audio features, amplitudes in the same units as Attractor::maxamplitude
+struct AudioLevels {
+    std::array<float, 4> bands = {0.0f, 0.0f, 0.0f, 0.0f};
+
+    float operator[](AudioBand band) const {
+        return bands[static_cast<size_t>(band)];
+    }
+};
+
+// one attractor entry of a scene file, unset fields fall back to the attractor's defaults
+struct InstanceConfig {
+    std::string attractor;
+    bool hasOffset = false;
+    float offsetX = 0.0f;
+    float offsetY = 0.0f;
+    bool hasScale = false;
+    float scale = 0.0f;
+    bool hasRotation = false;
+    std::array<float, 3> rotation = {0.0f, 0.0f, 0.0f};
+    size_t particles = 0;
+    TrailLength trail; // unset (0) falls back to the attractor's trailsize in frames
+    TrailSampling sampling;
+    std::vector<sf::Color> gradient;
+    AudioBand band = AudioBand::Full;
+    float maxAmplitude = 0.0f;
+};
+
+struct SceneConfig {
+    std::string audio;
+    float fov = 0.0f;         // radians, 0 keeps the scene's default
+    float eyeDistance = 0.0f; // 0 keeps the scene's default
+    std::vector<InstanceConfig> instances;
+};
+
+// reads a scene description, reporting problems on std::cerr
+bool loadScene(const std::string& path, SceneConfig& scene);
+
+// user controlled camera adjustments, applied on top of every instance's own transform
+struct ViewState {
+    float rotationX = 0.0f;
+    float rotationY = 0.0f;
+    float zoom = 1.0f;
+    float offsetX = 0.0f;
+    float offsetY = 0.0f;
+};
+
+struct AttractorInstance {
+    AttractorInstance(std::unique_ptr<Attractor> attractor, const InstanceConfig& config);
+
+    std::string name;                     // menu name, e.g. "Lorenz"
+    std::unique_ptr<Attractor> attractor; // defaults, never stepped
+    std::unique_ptr<Attractor> stepper;   // copy whose dt follows the audio every frame
+    float scale;
+    float offsetX;
+    float offsetY;
+    std::array<float, 3> rotation;
+    size_t particleCount;
+    AudioBand band;
+    Precision precision;
+    float maxAmplitude;
+    float trailAlpha;
+    Gradient gradient;
+    ColorScale colorScale;
+    Camera camera;
+    int respawnCounter;
+    uint32_t spawnGeneration;             // 0 for the initial set, counts up with every wave of respawns
+
+    std::vector<std::array<float, 3>> points;
+    std::vector<std::array<double, 3>> precisePoints; // the state itself with mixed precision, points is its float copy
+    TrailBuffer trails;
+    std::vector<sf::Vector2f> screenPositions;
+    std::vector<float> depths;
+    std::vector<uint16_t> depthKeys;
+    std::vector<float> colorValues;
+    std::vector<uint8_t> colorIndices;
+
+    float normalizedAmplitude(const AudioLevels& levels) const;
+    // makes room for count particles in every per-particle array
+    void reserve(size_t count);
+    // appends a particle to points and, with mixed precision, to the double state
+    void addPoint(const std::array<float, 3>& point);
+};
+
+// every attractor instance of a window, simulated together on one job system
+class Scene {
+public:
+    explicit Scene(JobSystem& jobs);
+
+    void addInstance(std::unique_ptr<Attractor> attractor, const InstanceConfig& config);
+    std::vector<AttractorInstance>& instances();
+    const std::vector<AttractorInstance>& instances() const;
+
+    // the same seed always produces the same initial points and respawns, whatever the number of threads
+    void initializePoints(unsigned seed);
+    void resetTransforms();
+    // a paused frame with the same inputs as the one before is skipped, nothing would change
+    // frameTime is the frame's duration in seconds, it only ages trails measured in seconds
+    void update(const AudioLevels& levels, bool paused, const ViewState& view, float screenWidth, float screenHeight, float frameTime);
+    // true when the last update was skipped, so everything derived from the previous frame is still valid
+    bool unchanged() const;
+    // depth range of the last update, shared by every instance
+    const DepthRange& depthRange() const;
+
+    ColorMode colorMode;
+    Projection projection;
+    float fov;         // vertical field of view of the perspective camera in radians
+    float eyeDistance; // camera distance as a multiple of the one that keeps the z = 0 plane at its orthographic size
+
+private:
+    // everything outside the particles that an update depends on
+    struct UpdateInputs {
+        AudioLevels levels;
+        ViewState view;
+        float screenWidth = 0.0f;
+        float screenHeight = 0.0f;
+        ColorMode colorMode = ColorMode::Amplitude;
+        Projection projection = Projection::Orthographic;
+        float fov = 0.0f;
+        float eyeDistance = 0.0f;
+    };
+
+    JobSystem& jobs;
+    std::vector<AttractorInstance> sceneInstances;
+    uint32_t seed;
+    UpdateInputs lastInputs;
+    bool hasLastInputs; // cleared whenever points or transforms change outside of update
+    bool skipped;
+    DepthRange sceneDepthRange;
+    std::vector<float> chunkMax;
+    std::vector<float> chunkMinDepth;
+    std::vector<float> chunkMaxDepth;
+
+    void respawn(AttractorInstance& instance);
+    void simulate(AttractorInstance& instance, const AudioLevels& levels, bool paused, float& minDepth, float& maxDepth);
+};
+
+#endif
@@ -0,0 +1,238 @@
+#include "session.h"
+#include <iostream>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include "binary_io.h"
+
+static const char MAGIC[4] = {'C', 'A', 'S', 'R'};
+static const uint16_t VERSION = 3; // 2: particles seeded by a counter-based generator, 3: frame times
+static const uint8_t FRAME_RECORD = 'F';
+static const uint8_t END_RECORD = 'E';
+static const uint8_t TAILS_FLAG = 1;
+
+InputEvent makeInput(InputKind kind, int x, int y) {
+    InputEvent event;
+    event.kind = kind;
+    event.x = static_cast<int16_t>(x);
+    event.y = static_cast<int16_t>(y);
+    return event;
+}
+
+InputEvent makeLensInput(float fov, float eyeDistance) {
+    float tenths = std::round(fov * 1800.0f / static_cast<float>(M_PI));
+    float hundredths = std::round(eyeDistance * 100.0f);
+    return makeInput(InputKind::Lens, static_cast<int>(std::min(std::max(tenths, 100.0f), 1500.0f)),
+                     static_cast<int>(std::min(std::max(hundredths, 25.0f), 1000.0f)));
+}
+
+void applyInput(const InputEvent& event, ViewState& view, bool& paused, bool& additive, Scene& scene) {
+    switch (event.kind) {
+        case InputKind::Rotate:
+            view.rotationX -= event.y * 0.006f;
+            view.rotationY -= event.x * 0.006f;
+            break;
+        case InputKind::Zoom: {
+            float zoomFactor = 1.1f;
+            if (event.x > 0) {
+                view.zoom *= zoomFactor;
+            } else {
+                view.zoom /= zoomFactor;
+            }
+            break;
+        }
+        case InputKind::Pan:
+            view.offsetX += event.x * 10.0f;
+            view.offsetY += event.y * 10.0f;
+            break;
+        case InputKind::Pause:
+            paused = !paused;
+            break;
+        case InputKind::Reset:
+            view = ViewState();
+            scene.resetTransforms();
+            break;
+        case InputKind::ColorMode:
+            scene.colorMode = nextColorMode(scene.colorMode);
+            break;
+        case InputKind::Projection:
+            scene.projection = scene.projection == Projection::Orthographic ? Projection::Perspective : Projection::Orthographic;
+            break;
+        case InputKind::Blend:
+            additive = !additive;
+            break;
+        case InputKind::Lens:
+            scene.fov = event.x * static_cast<float>(M_PI) / 1800.0f;
+            scene.eyeDistance = event.y / 100.0f;
+            break;
+    }
+}
+
+// 64-bit FNV-1a
+static void hashBytes(uint64_t& hash, const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+}
+
+static void hashVertices(uint64_t& hash, const std::vector<sf::Vertex>& vertices) {
+    for (const sf::Vertex& vertex : vertices) {
+        hashBytes(hash, &vertex.position, sizeof(vertex.position));
+        hashBytes(hash, &vertex.color, sizeof(vertex.color));
+    }
+}
+
+uint64_t outputHash(const Scene& scene, const DrawBatch& batch) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (const auto& instance : scene.instances()) {
+        if (!instance.points.empty()) {
+            hashBytes(hash, instance.points.data(), instance.points.size() * sizeof(instance.points[0]));
+        }
+    }
+    hashVertices(hash, batch.trailVertices);
+    hashVertices(hash, batch.pointVertices);
+    return hash;
+}
+
+static void writeEvent(std::ostream& out, const InputEvent& event) {
+    writeBinary(out, static_cast<uint8_t>(event.kind));
+    writeBinary(out, event.x);
+    writeBinary(out, event.y);
+}
+
+static bool readEvent(std::istream& in, InputEvent& event) {
+    uint8_t kind;
+    if (!readBinary(in, kind) || !readBinary(in, event.x) || !readBinary(in, event.y) || kind > static_cast<uint8_t>(InputKind::Lens)) {
+        return false;
+    }
+    event.kind = static_cast<InputKind>(kind);
+    return true;
+}
+
+SessionRecorder::SessionRecorder() : frameCount(0) {
+    // a frame rarely has more than a handful of events, so recording does not allocate per frame
+    events.reserve(64);
+}
+
+bool SessionRecorder::open(const std::string& path, const std::string& source) {
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cerr << "Error opening session log " << path << std::endl;
+        return false;
+    }
+    this->source = source;
+    return true;
+}
+
+bool SessionRecorder::isOpen() const {
+    return file.is_open();
+}
+
+void SessionRecorder::begin(unsigned seed, unsigned screenWidth, unsigned screenHeight) {
+    file.write(MAGIC, sizeof(MAGIC));
+    writeBinary(file, VERSION);
+    writeBinary(file, static_cast<uint32_t>(seed));
+    writeBinary(file, static_cast<uint16_t>(screenWidth));
+    writeBinary(file, static_cast<uint16_t>(screenHeight));
+    writeBinary(file, static_cast<uint16_t>(source.size()));
+    file.write(source.data(), source.size());
+}
+
+void SessionRecorder::input(const InputEvent& event) {
+    events.push_back(event);
+}
+
+void SessionRecorder::frame(const AudioLevels& levels, bool tails, float frameTime) {
+    writeBinary(file, FRAME_RECORD);
+    writeBinary(file, static_cast<uint8_t>(tails ? TAILS_FLAG : 0));
+    for (float band : levels.bands) {
+        writeBinary(file, band);
+    }
+    writeBinary(file, frameTime);
+    writeBinary(file, static_cast<uint16_t>(events.size()));
+    for (const InputEvent& event : events) {
+        writeEvent(file, event);
+    }
+    events.clear();
+    ++frameCount;
+}
+
+void SessionRecorder::close(uint64_t hash) {
+    writeBinary(file, END_RECORD);
+    writeBinary(file, frameCount);
+    writeBinary(file, hash);
+    file.close();
+}
+
+bool loadSession(const std::string& path, Session& session) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Error opening session log " << path << std::endl;
+        return false;
+    }
+
+    char magic[sizeof(MAGIC)];
+    uint16_t version;
+    uint32_t seed;
+    uint16_t width, height, sourceLength;
+    if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || !readBinary(file, version)) {
+        std::cerr << path << " is not a session log" << std::endl;
+        return false;
+    }
+    if (version != VERSION) {
+        std::cerr << path << ": unsupported session log version " << version << std::endl;
+        return false;
+    }
+    if (!readBinary(file, seed) || !readBinary(file, width) || !readBinary(file, height) || !readBinary(file, sourceLength)) {
+        std::cerr << path << ": truncated header" << std::endl;
+        return false;
+    }
+    session.source.resize(sourceLength);
+    if (!file.read(&session.source[0], sourceLength)) {
+        std::cerr << path << ": truncated header" << std::endl;
+        return false;
+    }
+    session.seed = seed;
+    session.screenWidth = width;
+    session.screenHeight = height;
+    session.frames.clear();
+    session.events.clear();
+    session.hasHash = false;
+
+    uint8_t tag;
+    while (readBinary(file, tag)) {
+        if (tag == END_RECORD) {
+            uint32_t frameCount;
+            if (readBinary(file, frameCount) && readBinary(file, session.hash) && frameCount == session.frames.size()) {
+                session.hasHash = true;
+            }
+            break;
+        }
+        uint8_t flags;
+        uint16_t eventCount;
+        SessionFrame frame;
+        bool complete = tag == FRAME_RECORD && readBinary(file, flags);
+        for (size_t i = 0; complete && i < frame.levels.bands.size(); ++i) {
+            complete = readBinary(file, frame.levels.bands[i]);
+        }
+        complete = complete && readBinary(file, frame.frameTime) && readBinary(file, eventCount);
+        frame.firstEvent = static_cast<uint32_t>(session.events.size());
+        frame.eventCount = complete ? eventCount : 0;
+        for (uint32_t i = 0; complete && i < frame.eventCount; ++i) {
+            InputEvent event;
+            complete = readEvent(file, event);
+            session.events.push_back(event);
+        }
+        if (!complete) {
+            // a recording cut short by a crash still replays up to its last whole frame
+            std::cerr << path << ": ignoring incomplete frame " << session.frames.size() << std::endl;
+            session.events.resize(frame.firstEvent);
+            break;
+        }
+        frame.tails = (flags & TAILS_FLAG) != 0;
+        session.frames.push_back(frame);
+    }
+    return true;
+}
@@ -0,0 +1,86 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include "scene.h"
+#include "batch.h"
+
+// user input that changes what is simulated or drawn, in the form it is recorded in
+enum class InputKind : uint8_t {
+    Rotate,     // x, y: mouse drag in pixels
+    Zoom,       // x: scroll direction
+    Pan,        // x, y: arrow key steps
+    Pause,
+    Reset,
+    ColorMode,
+    Projection,
+    Blend,
+    Lens        // x: field of view in tenths of a degree, y: camera distance in hundredths, both absolute
+};
+
+struct InputEvent {
+    InputKind kind;
+    int16_t x;
+    int16_t y;
+};
+
+InputEvent makeInput(InputKind kind, int x = 0, int y = 0);
+// a Lens event for a field of view in radians and a camera distance, clamped to the ranges the camera supports
+InputEvent makeLensInput(float fov, float eyeDistance);
+
+// the single place input is applied, shared by the window and by replays
+void applyInput(const InputEvent& event, ViewState& view, bool& paused, bool& additive, Scene& scene);
+
+// a fingerprint of the simulated points and of the vertices handed to the renderer
+uint64_t outputHash(const Scene& scene, const DrawBatch& batch);
+
+// writes everything a frame depends on to a compact binary log
+// layout: header (magic, version, seed, screen size, scene source), one record per frame, an end record with the output hash
+class SessionRecorder {
+public:
+    SessionRecorder();
+
+    // source is the attractor name or scene file the session was started with
+    bool open(const std::string& path, const std::string& source);
+    bool isOpen() const;
+
+    void begin(unsigned seed, unsigned screenWidth, unsigned screenHeight);
+    // input is buffered and written with the frame it was applied in
+    void input(const InputEvent& event);
+    void frame(const AudioLevels& levels, bool tails, float frameTime);
+    void close(uint64_t hash);
+
+private:
+    std::ofstream file;
+    std::string source;
+    std::vector<InputEvent> events;
+    uint32_t frameCount;
+};
+
+struct SessionFrame {
+    AudioLevels levels;
+    float frameTime; // seconds
+    bool tails;
+    uint32_t firstEvent;
+    uint32_t eventCount;
+};
+
+// a whole recorded session, loaded up front so replays don't time disk reads
+struct Session {
+    unsigned seed = 0;
+    unsigned screenWidth = 0;
+    unsigned screenHeight = 0;
+    std::string source;
+    std::vector<SessionFrame> frames;
+    std::vector<InputEvent> events;
+    bool hasHash = false; // false if the recording was cut short
+    uint64_t hash = 0;
+};
+
+// reads a log written by SessionRecorder, reporting problems on std::cerr
+bool loadSession(const std::string& path, Session& session);
+
+#endif
@@ -0,0 +1,112 @@
+#include "shared_state.h"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+size_t sharedSlotSize(uint32_t maxParticles) {
+    size_t size = sizeof(SharedFrameHeader) + static_cast<size_t>(maxParticles) * 5 * sizeof(float);
+    return (size + 63) / 64 * 64;
+}
+
+const SharedFrameHeader* sharedSlot(const SharedStateHeader* base, uint32_t slot) {
+    const char* bytes = reinterpret_cast<const char*>(base);
+    return reinterpret_cast<const SharedFrameHeader*>(bytes + SHARED_STATE_HEADER_SIZE + slot * base->slotSize);
+}
+
+SharedFrameHeader* sharedSlot(SharedStateHeader* base, uint32_t slot) {
+    char* bytes = reinterpret_cast<char*>(base);
+    return reinterpret_cast<SharedFrameHeader*>(bytes + SHARED_STATE_HEADER_SIZE + slot * base->slotSize);
+}
+
+SharedStateReader::SharedStateReader() : header(nullptr), mappedSize(0) {}
+
+SharedStateReader::~SharedStateReader() {
+    close();
+}
+
+bool SharedStateReader::open(const std::string& name) {
+    close();
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < SHARED_STATE_HEADER_SIZE) {
+        ::close(fd);
+        return false;
+    }
+    void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        std::cerr << "Error mapping " << name << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    const SharedStateHeader* mapped = static_cast<const SharedStateHeader*>(mapping);
+    if (mapped->magic != SHARED_STATE_MAGIC || mapped->version != SHARED_STATE_VERSION ||
+        SHARED_STATE_HEADER_SIZE + mapped->slotCount * mapped->slotSize > static_cast<size_t>(info.st_size) ||
+        mapped->slotSize < sharedSlotSize(mapped->maxParticles)) {
+        std::cerr << name << " is not a compatible particle state segment" << std::endl;
+        munmap(mapping, info.st_size);
+        return false;
+    }
+    header = mapped;
+    mappedSize = info.st_size;
+    return true;
+}
+
+void SharedStateReader::close() {
+    if (header) {
+        munmap(const_cast<SharedStateHeader*>(header), mappedSize);
+        header = nullptr;
+        mappedSize = 0;
+    }
+}
+
+bool SharedStateReader::isOpen() const {
+    return header != nullptr;
+}
+
+bool SharedStateReader::publisherClosed() const {
+    return header && header->closed.load(std::memory_order_acquire) != 0;
+}
+
+bool SharedStateReader::latest(SharedFrame& frame) const {
+    if (!header) {
+        return false;
+    }
+    uint64_t latest = header->latest.load(std::memory_order_acquire);
+    if (latest == 0) {
+        return false;
+    }
+    const SharedFrameHeader* slot = sharedSlot(header, static_cast<uint32_t>((latest - 1) % header->slotCount));
+    uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+    if (sequence & 1) {
+        return false;
+    }
+    const float* data = reinterpret_cast<const float*>(slot + 1);
+    frame.header = slot;
+    frame.sequence = sequence;
+    frame.positions = data;
+    frame.projected = data + static_cast<size_t>(header->maxParticles) * 3;
+    return true;
+}
+
+bool SharedStateReader::validate(const SharedFrame& frame) const {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return frame.header && frame.header->sequence.load(std::memory_order_relaxed) == frame.sequence;
+}
+
+uint32_t SharedStateReader::maxParticles() const {
+    return header ? header->maxParticles : 0;
+}
+
+uint32_t SharedStateReader::instanceEnd(const SharedInstance& instance) const {
+    uint64_t end = static_cast<uint64_t>(instance.first) + instance.count;
+    return static_cast<uint32_t>(std::min<uint64_t>(end, maxParticles()));
+}
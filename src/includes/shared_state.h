@@ -0,0 +1,99 @@
+#ifndef SHARED_STATE_H
+#define SHARED_STATE_H
+
+// layout of the live particle state published in POSIX shared memory, plus the reader side
+// kept free of SFML so that other tools only need this header and shared_state.cpp
+//
+// the segment is a header followed by a ring of frame slots; the publisher writes frame n into slot
+// n % slotCount under a per-slot seqlock: the sequence is odd while the slot is written and even once it
+// is complete, so a reader that sees the same even sequence before and after reading got a whole frame
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+const char* const SHARED_STATE_NAME = "/chaos-attractors";
+const uint32_t SHARED_STATE_MAGIC = 0x43415353; // "CASS"
+const uint32_t SHARED_STATE_VERSION = 1;
+const uint32_t SHARED_STATE_MAX_INSTANCES = 16;
+
+const size_t SHARED_STATE_HEADER_SIZE = 64; // the first slot starts here
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "shared memory counters must be lock free");
+
+struct SharedStateHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t maxParticles; // per slot, over all instances
+    uint64_t slotSize;     // bytes, including the slot header
+    std::atomic<uint64_t> latest; // number of the newest complete frame plus one, 0 before the first
+    std::atomic<uint32_t> closed; // set when the publisher shuts down
+};
+
+struct SharedInstance {
+    char attractor[16];
+    uint32_t first; // index of the instance's first particle in the slot's arrays
+    uint32_t count;
+};
+
+// followed by maxParticles x,y,z positions and then maxParticles x,y screen coordinates
+struct SharedFrameHeader {
+    std::atomic<uint64_t> sequence;
+    uint64_t frame;
+    float audio[4]; // full, low, mid and high band amplitude
+    float screenWidth;
+    float screenHeight;
+    uint32_t instanceCount;
+    uint32_t particleCount;
+    SharedInstance instances[SHARED_STATE_MAX_INSTANCES];
+};
+
+static_assert(sizeof(SharedStateHeader) <= SHARED_STATE_HEADER_SIZE, "header overlaps the first slot");
+
+// size in bytes of one slot for a given particle capacity, a multiple of 64 so slots don't share cache lines
+size_t sharedSlotSize(uint32_t maxParticles);
+// the slot with the given index in the segment starting at base
+const SharedFrameHeader* sharedSlot(const SharedStateHeader* base, uint32_t slot);
+SharedFrameHeader* sharedSlot(SharedStateHeader* base, uint32_t slot);
+
+// a frame read in place from the mapping, no data is copied
+struct SharedFrame {
+    const SharedFrameHeader* header = nullptr;
+    uint64_t sequence = 0;
+    const float* positions = nullptr; // 3 floats per particle
+    const float* projected = nullptr; // 2 floats per particle, in pixels, NaN for particles behind the camera
+};
+
+class SharedStateReader {
+public:
+    SharedStateReader();
+    ~SharedStateReader();
+
+    SharedStateReader(const SharedStateReader&) = delete;
+    SharedStateReader& operator=(const SharedStateReader&) = delete;
+
+    // maps the segment read only, false if no publisher has created it
+    bool open(const std::string& name = SHARED_STATE_NAME);
+    void close();
+    bool isOpen() const;
+    // true once the publisher has shut down, a restarted publisher needs a fresh open
+    bool publisherClosed() const;
+
+    // the newest complete frame, false if there is none yet or it is being overwritten
+    bool latest(SharedFrame& frame) const;
+    // whether everything read from frame so far is consistent; check after reading, not before
+    bool validate(const SharedFrame& frame) const;
+
+    // particle capacity of every slot, 0 when not open
+    uint32_t maxParticles() const;
+    // one past the instance's last particle, clamped to the slot so a torn read never indexes past the mapping
+    uint32_t instanceEnd(const SharedInstance& instance) const;
+
+private:
+    const SharedStateHeader* header;
+    size_t mappedSize;
+};
+
+#endif
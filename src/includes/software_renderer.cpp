@@ -0,0 +1,280 @@
+#include "software_renderer.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include "alloc_tracker.h"
+
+SoftwareRenderer::SoftwareRenderer(JobSystem& jobs)
+    : jobs(jobs), frameWidth(0), frameHeight(0), tilesX(0), tilesY(0),
+      rasterizedBatch(nullptr), rasterizedVersion(0), rasterizedAdditive(false) {}
+
+unsigned SoftwareRenderer::width() const {
+    return frameWidth;
+}
+
+unsigned SoftwareRenderer::height() const {
+    return frameHeight;
+}
+
+const std::vector<sf::Uint8>& SoftwareRenderer::pixels() const {
+    return framebuffer;
+}
+
+bool SoftwareRenderer::save(const std::string& path) const {
+    sf::Image image;
+    image.create(frameWidth, frameHeight, framebuffer.data());
+    if (!image.saveToFile(path)) {
+        std::cerr << "Error writing " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void SoftwareRenderer::resize(unsigned width, unsigned height) {
+    if (width == frameWidth && height == frameHeight) {
+        return;
+    }
+    AllocationStage stage("raster growth", true);
+    frameWidth = width;
+    frameHeight = height;
+    tilesX = (width + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    tilesY = (height + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    size_t tiles = static_cast<size_t>(tilesX) * tilesY;
+    framebuffer.assign(static_cast<size_t>(width) * height * 4, 0);
+    binCounts.assign(tiles * jobs.size(), 0);
+    binCursors.assign(tiles * jobs.size(), 0);
+    binStarts.assign(tiles + 1, 0);
+}
+
+// the pixels a primitive can touch, false if it is entirely off screen
+bool SoftwareRenderer::bounds(const DrawBatch& batch, size_t primitive, Bounds& pixels) const {
+    size_t segments = batch.trailVertices.size() / 2;
+    float minX, minY, maxX, maxY;
+    if (primitive < segments) {
+        // one pixel of anti-aliasing falloff around the line
+        const sf::Vector2f& a = batch.trailVertices[primitive * 2].position;
+        const sf::Vector2f& b = batch.trailVertices[primitive * 2 + 1].position;
+        minX = std::min(a.x, b.x) - 1.0f;
+        minY = std::min(a.y, b.y) - 1.0f;
+        maxX = std::max(a.x, b.x) + 1.0f;
+        maxY = std::max(a.y, b.y) + 1.0f;
+    } else {
+        // point quads are axis aligned, corner 0 is the top left and corner 2 the bottom right
+        const sf::Vertex* quad = &batch.pointVertices[(primitive - segments) * 4];
+        minX = quad[0].position.x;
+        minY = quad[0].position.y;
+        maxX = quad[2].position.x;
+        maxY = quad[2].position.y;
+    }
+    // written so that NaN positions are rejected too
+    if (!(maxX >= 0.0f && maxY >= 0.0f && minX < frameWidth && minY < frameHeight)) {
+        return false;
+    }
+    pixels.x0 = static_cast<int>(std::max(minX, 0.0f));
+    pixels.y0 = static_cast<int>(std::max(minY, 0.0f));
+    pixels.x1 = static_cast<int>(std::min(maxX, frameWidth - 1.0f));
+    pixels.y1 = static_cast<int>(std::min(maxY, frameHeight - 1.0f));
+    return true;
+}
+
+static inline void unpack(const sf::Color& color, float out[4]) {
+    out[0] = color.r;
+    out[1] = color.g;
+    out[2] = color.b;
+    out[3] = color.a;
+}
+
+// same equations as sf::BlendAlpha and sf::BlendAdd on an opaque target
+static inline void blend(sf::Uint8* pixel, const float color[4], float coverage, bool additive) {
+    float alpha = color[3] * (1.0f / 255.0f) * coverage;
+    for (int c = 0; c < 3; ++c) {
+        float value = additive ? std::min(pixel[c] + color[c] * alpha, 255.0f)
+                               : pixel[c] + (color[c] - pixel[c]) * alpha;
+        pixel[c] = static_cast<sf::Uint8>(value + 0.5f);
+    }
+}
+
+// one pixel wide line, coverage falls off linearly with the distance from the pixel center
+// the color is interpolated along the segment like SFML interpolates vertex colors
+static void rasterizeSegment(sf::Uint8* framebuffer, unsigned width, const sf::Vertex& a, const sf::Vertex& b,
+                             int x0, int y0, int x1, int y1, bool additive) {
+    float dx = b.position.x - a.position.x;
+    float dy = b.position.y - a.position.y;
+    float lengthSquared = dx * dx + dy * dy;
+    float inverseLength = lengthSquared > 0.0f ? 1.0f / lengthSquared : 0.0f;
+    float start[4];
+    float delta[4];
+    unpack(a.color, start);
+    unpack(b.color, delta);
+    for (int c = 0; c < 4; ++c) {
+        delta[c] -= start[c];
+    }
+
+    for (int y = y0; y <= y1; ++y) {
+        float py = y + 0.5f - a.position.y;
+        sf::Uint8* row = framebuffer + static_cast<size_t>(y) * width * 4;
+        for (int x = x0; x <= x1; ++x) {
+            float px = x + 0.5f - a.position.x;
+            float t = std::min(std::max((px * dx + py * dy) * inverseLength, 0.0f), 1.0f);
+            float ex = px - dx * t;
+            float ey = py - dy * t;
+            float distanceSquared = ex * ex + ey * ey;
+            if (distanceSquared >= 1.0f) {
+                continue;
+            }
+            float color[4];
+            for (int c = 0; c < 4; ++c) {
+                color[c] = start[c] + delta[c] * t;
+            }
+            blend(row + x * 4, color, 1.0f - std::sqrt(distanceSquared), additive);
+        }
+    }
+}
+
+// box filtered rectangle, coverage is the overlap of the quad with each pixel
+static void rasterizeQuad(sf::Uint8* framebuffer, unsigned width, const sf::Vertex* quad,
+                          int x0, int y0, int x1, int y1, bool additive) {
+    float left = quad[0].position.x;
+    float top = quad[0].position.y;
+    float right = quad[2].position.x;
+    float bottom = quad[2].position.y;
+    float color[4];
+    unpack(quad[0].color, color);
+
+    for (int y = y0; y <= y1; ++y) {
+        float coverageY = std::min(bottom, y + 1.0f) - std::max(top, static_cast<float>(y));
+        if (coverageY <= 0.0f) {
+            continue;
+        }
+        sf::Uint8* row = framebuffer + static_cast<size_t>(y) * width * 4;
+        for (int x = x0; x <= x1; ++x) {
+            float coverageX = std::min(right, x + 1.0f) - std::max(left, static_cast<float>(x));
+            if (coverageX > 0.0f) {
+                blend(row + x * 4, color, coverageX * coverageY, additive);
+            }
+        }
+    }
+}
+
+void SoftwareRenderer::rasterizeTile(const DrawBatch& batch, bool additive, unsigned tile) {
+    int tileX0 = static_cast<int>(tile % tilesX) * RASTER_TILE_SIZE;
+    int tileY0 = static_cast<int>(tile / tilesX) * RASTER_TILE_SIZE;
+    int tileX1 = std::min(tileX0 + RASTER_TILE_SIZE, static_cast<int>(frameWidth)) - 1;
+    int tileY1 = std::min(tileY0 + RASTER_TILE_SIZE, static_cast<int>(frameHeight)) - 1;
+
+    for (int y = tileY0; y <= tileY1; ++y) {
+        sf::Uint8* row = &framebuffer[(static_cast<size_t>(y) * frameWidth + tileX0) * 4];
+        for (int x = tileX0; x <= tileX1; ++x, row += 4) {
+            row[0] = 0;
+            row[1] = 0;
+            row[2] = 0;
+            row[3] = 255;
+        }
+    }
+
+    size_t segments = batch.trailVertices.size() / 2;
+    Bounds area;
+    for (uint32_t i = binStarts[tile]; i < binStarts[tile + 1]; ++i) {
+        uint32_t primitive = bins[i];
+        bounds(batch, primitive, area);
+        int x0 = std::max(area.x0, tileX0);
+        int y0 = std::max(area.y0, tileY0);
+        int x1 = std::min(area.x1, tileX1);
+        int y1 = std::min(area.y1, tileY1);
+        if (primitive < segments) {
+            rasterizeSegment(framebuffer.data(), frameWidth, batch.trailVertices[primitive * 2],
+                             batch.trailVertices[primitive * 2 + 1], x0, y0, x1, y1, additive);
+        } else {
+            rasterizeQuad(framebuffer.data(), frameWidth, &batch.pointVertices[(primitive - segments) * 4],
+                          x0, y0, x1, y1, additive);
+        }
+    }
+}
+
+bool SoftwareRenderer::rasterize(const DrawBatch& batch, bool additive, unsigned width, unsigned height) {
+    if (rasterizedBatch == &batch && rasterizedVersion == batch.version() && rasterizedAdditive == additive &&
+        width == frameWidth && height == frameHeight) {
+        return false;
+    }
+    rasterizedBatch = &batch;
+    rasterizedVersion = batch.version();
+    rasterizedAdditive = additive;
+    resize(width, height);
+    // trails first, then points, the same order as the SFML backend draws them
+    size_t primitives = batch.trailVertices.size() / 2 + batch.pointVertices.size() / 4;
+    size_t tiles = static_cast<size_t>(tilesX) * tilesY;
+
+    // counting pass, every chunk tallies its own slice of the primitives per tile
+    std::fill(binCounts.begin(), binCounts.end(), 0);
+    jobs.parallelFor(primitives, [&](size_t chunk, size_t begin, size_t end) {
+        uint32_t* counts = &binCounts[chunk * tiles];
+        Bounds area;
+        for (size_t primitive = begin; primitive < end; ++primitive) {
+            if (!bounds(batch, primitive, area)) {
+                continue;
+            }
+            for (int ty = area.y0 / RASTER_TILE_SIZE; ty <= area.y1 / RASTER_TILE_SIZE; ++ty) {
+                for (int tx = area.x0 / RASTER_TILE_SIZE; tx <= area.x1 / RASTER_TILE_SIZE; ++tx) {
+                    ++counts[ty * tilesX + tx];
+                }
+            }
+        }
+    });
+
+    // chunks cover the primitives in order, so laying their entries out chunk after chunk inside each tile keeps draw order
+    uint32_t total = 0;
+    for (size_t tile = 0; tile < tiles; ++tile) {
+        binStarts[tile] = total;
+        for (size_t chunk = 0; chunk < jobs.size(); ++chunk) {
+            binCursors[chunk * tiles + tile] = total;
+            total += binCounts[chunk * tiles + tile];
+        }
+    }
+    binStarts[tiles] = total;
+    if (bins.size() < total) {
+        AllocationStage stage("raster growth", true);
+        bins.resize(total + total / 2);
+    }
+
+    // the same count splits into the same chunks, so this pass lands exactly on the ranges counted above
+    jobs.parallelFor(primitives, [&](size_t chunk, size_t begin, size_t end) {
+        uint32_t* cursors = &binCursors[chunk * tiles];
+        Bounds area;
+        for (size_t primitive = begin; primitive < end; ++primitive) {
+            if (!bounds(batch, primitive, area)) {
+                continue;
+            }
+            for (int ty = area.y0 / RASTER_TILE_SIZE; ty <= area.y1 / RASTER_TILE_SIZE; ++ty) {
+                for (int tx = area.x0 / RASTER_TILE_SIZE; tx <= area.x1 / RASTER_TILE_SIZE; ++tx) {
+                    bins[cursors[ty * tilesX + tx]++] = static_cast<uint32_t>(primitive);
+                }
+            }
+        }
+    });
+
+    // the attractor crowds the middle of the screen, a prime stride spreads neighbouring tiles over every chunk
+    size_t stride = tiles % 7919 == 0 ? 1 : 7919;
+    jobs.parallelFor(tiles, [&](size_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            rasterizeTile(batch, additive, static_cast<unsigned>(i * stride % tiles));
+        }
+    });
+    return true;
+}
+
+void SoftwareRenderer::draw(sf::RenderTarget& target, const DrawBatch& batch, bool additive) {
+    sf::Vector2u size = target.getSize();
+    if (size.x == 0 || size.y == 0) {
+        return;
+    }
+    bool changed = rasterize(batch, additive, size.x, size.y);
+    if (texture.getSize().x != size.x || texture.getSize().y != size.y) {
+        texture.create(size.x, size.y);
+        sprite.setTexture(texture, true);
+        changed = true;
+    }
+    if (changed) {
+        texture.update(framebuffer.data());
+    }
+    target.draw(sprite);
+}
@@ -0,0 +1,59 @@
+#ifndef SOFTWARE_RENDERER_H
+#define SOFTWARE_RENDERER_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <SFML/Graphics.hpp>
+#include "renderer.h"
+#include "jobs.h"
+
+const int RASTER_TILE_SIZE = 64;
+
+// rasterizes batches on the CPU for machines without a GPU, where SFML falls back to slow software GL
+// primitives are binned into screen tiles in draw order and the tiles are filled in parallel, so blending
+// stays back to front inside every tile without any locking
+class SoftwareRenderer : public Renderer {
+public:
+    explicit SoftwareRenderer(JobSystem& jobs);
+
+    // rasterizes the batch and uploads the framebuffer as a single texture, an unchanged batch just redraws the texture
+    void draw(sf::RenderTarget& target, const DrawBatch& batch, bool additive) override;
+
+    // fills the framebuffer with the batch over a black background, false if it already holds exactly that
+    bool rasterize(const DrawBatch& batch, bool additive, unsigned width, unsigned height);
+    unsigned width() const;
+    unsigned height() const;
+    // RGBA, 8 bits per channel, rows top to bottom
+    const std::vector<sf::Uint8>& pixels() const;
+    // writes the framebuffer in any format sf::Image supports, reporting problems on std::cerr
+    bool save(const std::string& path) const;
+
+private:
+    struct Bounds {
+        int x0, y0, x1, y1; // inclusive pixel range
+    };
+
+    JobSystem& jobs;
+    unsigned frameWidth;
+    unsigned frameHeight;
+    unsigned tilesX;
+    unsigned tilesY;
+    std::vector<sf::Uint8> framebuffer;
+    std::vector<uint32_t> binCounts;  // per chunk and tile
+    std::vector<uint32_t> binCursors; // per chunk and tile, where the chunk's next entry goes
+    std::vector<uint32_t> binStarts;  // per tile, plus one past the end
+    std::vector<uint32_t> bins;       // primitive indices grouped by tile, in draw order
+    sf::Texture texture;
+    sf::Sprite sprite;
+    // what the framebuffer currently shows
+    const DrawBatch* rasterizedBatch;
+    uint64_t rasterizedVersion;
+    bool rasterizedAdditive;
+
+    void resize(unsigned width, unsigned height);
+    bool bounds(const DrawBatch& batch, size_t primitive, Bounds& pixels) const;
+    void rasterizeTile(const DrawBatch& batch, bool additive, unsigned tile);
+};
+
+#endif
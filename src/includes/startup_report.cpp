@@ -0,0 +1,49 @@
+#include "startup_report.h"
+#include <iomanip>
+
+StartupReport::StartupReport() : origin(Clock::now()), printed(false) {}
+
+void StartupReport::restart() {
+    std::lock_guard<std::mutex> lock(mutex);
+    origin = Clock::now();
+    phases.clear();
+    printed = false;
+}
+
+void StartupReport::begin(const std::string& phase) {
+    std::lock_guard<std::mutex> lock(mutex);
+    phases.push_back({phase, Clock::now(), Clock::time_point(), false});
+}
+
+void StartupReport::end(const std::string& phase) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& entry : phases) {
+        if (entry.name == phase && !entry.done) {
+            entry.stop = Clock::now();
+            entry.done = true;
+            return;
+        }
+    }
+}
+
+bool StartupReport::printWhenComplete(std::ostream& out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (printed) {
+        return false;
+    }
+    for (const auto& entry : phases) {
+        if (!entry.done) {
+            return false;
+        }
+    }
+
+    out << "==== Startup ====" << std::endl;
+    for (const auto& entry : phases) {
+        double start = std::chrono::duration<double, std::milli>(entry.start - origin).count();
+        double stop = std::chrono::duration<double, std::milli>(entry.stop - origin).count();
+        out << std::left << std::setw(18) << entry.name << std::right << std::fixed << std::setprecision(1)
+            << std::setw(9) << start << " -> " << std::setw(9) << stop << " ms  (" << stop - start << " ms)" << std::endl;
+    }
+    printed = true;
+    return true;
+}
@@ -0,0 +1,39 @@
+#ifndef STARTUP_REPORT_H
+#define STARTUP_REPORT_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <ostream>
+
+// wall clock spans of the startup phases, which may overlap when they run on different threads
+class StartupReport {
+public:
+    StartupReport();
+
+    // drops everything recorded so far, e.g. time spent waiting on the interactive prompt
+    void restart();
+    void begin(const std::string& phase);
+    void end(const std::string& phase);
+
+    // prints every phase once all begun phases have ended, returns whether it printed
+    bool printWhenComplete(std::ostream& out);
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Phase {
+        std::string name;
+        Clock::time_point start;
+        Clock::time_point stop;
+        bool done;
+    };
+
+    Clock::time_point origin;
+    std::vector<Phase> phases;
+    std::mutex mutex;
+    bool printed;
+};
+
+#endif
@@ -0,0 +1,319 @@
+#include "trail.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+// false for NaN and for values the int16 range can't hold, -32768 is left free for TRAIL_CULLED
+static bool toFixed(float value, float scale, int16_t& fixed) {
+    float scaled = value * scale;
+    if (!(scaled >= -32767.0f && scaled < 32768.0f)) {
+        return false;
+    }
+    fixed = static_cast<int16_t>(std::floor(scaled));
+    return true;
+}
+
+static bool culled(const TrailVertex& vertex) {
+    return vertex.x == TRAIL_CULLED;
+}
+
+bool parseTrailLength(const std::string& text, TrailLength& length) {
+    char* end = nullptr;
+    float value = std::strtof(text.c_str(), &end);
+    std::string unit = end ? end : "";
+    if (end == text.c_str() || !(value > 0.0f)) {
+        return false;
+    }
+    if (unit.empty()) {
+        length.unit = TrailLength::Frames;
+        length.value = value;
+    } else if (unit == "s" && value <= TRAIL_MAX_SECONDS) {
+        length.unit = TrailLength::Seconds;
+        length.value = value;
+    } else if (unit == "px") {
+        length.unit = TrailLength::Pixels;
+        length.value = value;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// a trail in frames needs a slot per frame when its particle is fast enough to commit every frame, one in seconds
+// a slot per frame at the frame rate limit; one in pixels needs one per spacing, doubled for the vertices added at turns
+static size_t trailCapacity(const TrailLength& length, const TrailSampling& sampling) {
+    float slots;
+    switch (length.unit) {
+        case TrailLength::Frames:
+            slots = std::round(length.value);
+            break;
+        case TrailLength::Seconds:
+            slots = std::ceil(length.value * TRAIL_MAX_FRAME_RATE) + 1.0f;
+            break;
+        default:
+            slots = std::ceil(2.0f * length.value / std::max(sampling.spacing, 0.125f)) + 2.0f;
+            break;
+    }
+    return static_cast<size_t>(std::max(std::min(slots, static_cast<float>(UINT16_MAX)), 2.0f));
+}
+
+static uint16_t trailMaxAge(const TrailLength& length, size_t capacity) {
+    if (length.unit == TrailLength::Seconds) {
+        return static_cast<uint16_t>(std::round(std::min(length.value, TRAIL_MAX_SECONDS) * 1000.0f));
+    }
+    return static_cast<uint16_t>(capacity - 1);
+}
+
+TrailBuffer::TrailBuffer(const TrailLength& length, const TrailSampling& sampling)
+    : trailLength(length), capacity(trailCapacity(length, sampling)), trailCount(0), clock(0),
+      maxAge(trailMaxAge(length, capacity)), elapsed(0.0), spacing(sampling.spacing),
+      spacingSquared(sampling.spacing * sampling.spacing * (1 << TRAIL_MAX_FIXED_SHIFT) * (1 << TRAIL_MAX_FIXED_SHIFT)),
+      screenWidth(0.0f), screenHeight(0.0f), originX(0.0f), originY(0.0f), depthOrigin(0.0f),
+      fixedScale(static_cast<float>(1 << TRAIL_MAX_FIXED_SHIFT)),
+      minTurnCosine(std::cos(sampling.turn))
+{
+}
+
+void TrailBuffer::setScreen(float screenWidth, float screenHeight) {
+    if (screenWidth == this->screenWidth && screenHeight == this->screenHeight) {
+        return;
+    }
+    this->screenWidth = screenWidth;
+    this->screenHeight = screenHeight;
+    originX = screenWidth / 2.0f;
+    originY = screenHeight / 2.0f;
+    // the finest precision that still stores points a whole screen past the centre, e.g. 1/4 px on a 5K screen
+    int shift = TRAIL_MAX_FIXED_SHIFT;
+    while (shift > 0 && std::max(screenWidth, screenHeight) * (1 << shift) > 32767.0f) {
+        --shift;
+    }
+    fixedScale = static_cast<float>(1 << shift);
+    spacingSquared = spacing * spacing * fixedScale * fixedScale;
+    // stored vertices are relative to the old origin and precision
+    std::fill(counts.begin(), counts.end(), 0);
+}
+
+void TrailBuffer::setDepthOrigin(float centreDepth) {
+    depthOrigin = centreDepth;
+}
+
+void TrailBuffer::reserve(size_t trailCount) {
+    vertices.reserve(trailCount * capacity);
+    heads.reserve(trailCount);
+    counts.reserve(trailCount);
+}
+
+void TrailBuffer::resize(size_t trailCount) {
+    this->trailCount = trailCount;
+    vertices.resize(trailCount * capacity);
+    heads.resize(trailCount, 0);
+    counts.resize(trailCount, 0);
+}
+
+void TrailBuffer::shrinkToFit() {
+    vertices.shrink_to_fit();
+    heads.shrink_to_fit();
+    counts.shrink_to_fit();
+}
+
+size_t TrailBuffer::size() const {
+    return trailCount;
+}
+
+size_t TrailBuffer::length(size_t trail) const {
+    return counts[trail];
+}
+
+size_t TrailBuffer::vertexCount() const {
+    size_t total = 0;
+    for (size_t i = 0; i < trailCount; ++i) {
+        total += counts[i];
+    }
+    return total;
+}
+
+size_t TrailBuffer::segmentCount() const {
+    size_t segments = 0;
+    for (size_t i = 0; i < trailCount; ++i) {
+        if (counts[i] > 1) {
+            segments += counts[i] - 1;
+        }
+    }
+    return segments;
+}
+
+void TrailBuffer::tick(float frameTime) {
+    if (trailLength.unit != TrailLength::Seconds) {
+        ++clock;
+        return;
+    }
+    // a stall ages trails by at most a second, so no kept stamp wraps around before it is dropped
+    elapsed += std::min(std::max(frameTime, 0.0f), 1.0f);
+    clock = static_cast<uint16_t>(static_cast<uint64_t>(elapsed * 1000.0));
+}
+
+void TrailBuffer::push(size_t trail, float screenX, float screenY, uint8_t colorIndex, float depth) {
+    TrailVertex* ring = &vertices[trail * capacity];
+    size_t head = heads[trail];
+    size_t count = counts[trail];
+    auto at = [&](size_t i) -> TrailVertex& {
+        size_t slot = head + i;
+        return ring[slot >= capacity ? slot - capacity : slot];
+    };
+
+    // vertices older than the trail are dropped from the tail, keeping at least the head
+    if (trailLength.unit != TrailLength::Pixels) {
+        while (count > 1 && static_cast<uint16_t>(clock - at(0).stamp) > maxAge) {
+            head = head + 1 == capacity ? 0 : head + 1;
+            --count;
+        }
+        heads[trail] = static_cast<uint16_t>(head);
+    }
+
+    TrailVertex vertex;
+    bool visible = toFixed(screenX - originX, fixedScale, vertex.x) && toFixed(screenY - originY, fixedScale, vertex.y);
+    if (!visible) {
+        vertex.x = TRAIL_CULLED;
+        vertex.y = 0;
+    }
+    vertex.colorIndex = colorIndex;
+    // only an attractor zoomed far past the screen reaches the clamp, and then its x and y are out of range as well
+    vertex.depth = static_cast<int16_t>(std::min(std::max(std::round(depth - depthOrigin), -32768.0f), 32767.0f));
+    vertex.stamp = clock;
+
+    // a run of culled frames is a single break
+    if (!visible && count >= 1 && culled(at(count - 1))) {
+        at(count - 1) = vertex;
+        return;
+    }
+
+    // the head slides along with the particle until it is far enough from the last fixed vertex or the path bends
+    if (visible && count >= 2 && !culled(at(count - 1)) && !culled(at(count - 2))) {
+        const TrailVertex& base = at(count - 2);
+        float dx = static_cast<float>(vertex.x - base.x);
+        float dy = static_cast<float>(vertex.y - base.y);
+        float distanceSquared = dx * dx + dy * dy;
+        bool slide = distanceSquared < spacingSquared;
+        const float minTurnDistance = fixedScale * fixedScale; // 1 px
+        if (slide && count >= 3 && !culled(at(count - 3)) && distanceSquared >= minTurnDistance) {
+            const TrailVertex& before = at(count - 3);
+            float ax = static_cast<float>(base.x - before.x);
+            float ay = static_cast<float>(base.y - before.y);
+            float lengths = (ax * ax + ay * ay) * distanceSquared;
+            slide = lengths <= 0.0f || ax * dx + ay * dy >= minTurnCosine * std::sqrt(lengths);
+        }
+        if (slide) {
+            at(count - 1) = vertex;
+            counts[trail] = static_cast<uint16_t>(count);
+            return;
+        }
+    }
+
+    // the slot after the newest vertex, overwriting the oldest once the ring is full
+    at(count < capacity ? count : 0) = vertex;
+    if (count < capacity) {
+        counts[trail] = static_cast<uint16_t>(count + 1);
+    } else {
+        counts[trail] = static_cast<uint16_t>(count);
+        heads[trail] = static_cast<uint16_t>(head + 1 == capacity ? 0 : head + 1);
+    }
+}
+
+void TrailBuffer::expand(const GradientLUT& lut, float maxAlpha, std::vector<sf::Vertex>& out,
+                         std::vector<uint16_t>* segmentKeys, const DepthRange* depthRange) const {
+    size_t segments = segmentCount();
+    size_t vertexBase = out.size();
+    out.resize(vertexBase + segments * 2);
+    uint16_t* keys = nullptr;
+    if (segmentKeys) {
+        size_t keyBase = segmentKeys->size();
+        segmentKeys->resize(keyBase + segments);
+        keys = segmentKeys->data() + keyBase;
+    }
+
+    const float invFixed = 1.0f / fixedScale;
+    const bool pixels = trailLength.unit == TrailLength::Pixels;
+    // frames and seconds: a vertex of age a gets (maxAge - a) / (maxAge + 1) of maxAlpha, fading linearly with age
+    const float alphaPerTick = maxAlpha / (maxAge + 1.0f);
+    const float newestAlpha = static_cast<float>(maxAge);
+    const float alphaPerPixel = maxAlpha / trailLength.value;
+    sf::Vertex* dst = out.data() + vertexBase;
+    for (size_t i = 0; i < trailCount; ++i) {
+        size_t count = counts[i];
+        if (count < 2) {
+            continue;
+        }
+        const TrailVertex* ring = &vertices[i * capacity];
+        size_t head = heads[i];
+        auto at = [&](size_t j) -> const TrailVertex& {
+            size_t slot = head + j;
+            return ring[slot >= capacity ? slot - capacity : slot];
+        };
+
+        // pixels: walk back from the head until the trail is long enough or breaks, the oldest kept segment is cut to fit
+        size_t first = 0;
+        float firstFraction = 0.0f; // how much of the first segment is cut off
+        float total = 0.0f;         // length from the (cut) first vertex to the head
+        if (pixels) {
+            first = count - 1;
+            while (first > 0) {
+                const TrailVertex& a = at(first - 1);
+                const TrailVertex& b = at(first);
+                if (culled(a) || culled(b)) {
+                    break;
+                }
+                float length = std::hypot(static_cast<float>(b.x - a.x), static_cast<float>(b.y - a.y)) * invFixed;
+                if (total + length >= trailLength.value) {
+                    firstFraction = length > 0.0f ? 1.0f - (trailLength.value - total) / length : 0.0f;
+                    total = trailLength.value;
+                    --first;
+                    break;
+                }
+                total += length;
+                --first;
+            }
+        }
+
+        // each segment repeats its start vertex from the previous one, so the result matches a LineStrip per trail
+        float travelled = 0.0f;
+        for (size_t j = first + 1; j < count; ++j) {
+            const TrailVertex& a = at(j - 1);
+            const TrailVertex& b = at(j);
+            if (culled(a) || culled(b)) {
+                continue;
+            }
+            sf::Vector2f start(a.x * invFixed + originX, a.y * invFixed + originY);
+            sf::Vector2f end(b.x * invFixed + originX, b.y * invFixed + originY);
+            float startAlpha, endAlpha;
+            if (pixels) {
+                if (j == first + 1) {
+                    start += (end - start) * firstFraction;
+                }
+                float length = std::hypot(end.x - start.x, end.y - start.y);
+                startAlpha = maxAlpha - (total - travelled) * alphaPerPixel;
+                travelled += length;
+                endAlpha = maxAlpha - (total - travelled) * alphaPerPixel;
+            } else {
+                startAlpha = (newestAlpha - static_cast<uint16_t>(clock - a.stamp)) * alphaPerTick;
+                endAlpha = (newestAlpha - static_cast<uint16_t>(clock - b.stamp)) * alphaPerTick;
+            }
+
+            dst[0].position = start;
+            dst[0].color = lut[a.colorIndex];
+            dst[0].color.a = static_cast<sf::Uint8>(std::max(startAlpha, 0.0f));
+            dst[1].position = end;
+            dst[1].color = lut[b.colorIndex];
+            dst[1].color.a = static_cast<sf::Uint8>(std::max(endAlpha, 0.0f));
+            dst += 2;
+            if (keys) {
+                *keys++ = static_cast<uint16_t>((depthRange->key(a.depth + depthOrigin) + depthRange->key(b.depth + depthOrigin)) / 2);
+            }
+        }
+    }
+
+    // trails in pixels and breaks may have used fewer segments than the bound reserved above, shrinking never reallocates
+    out.resize(dst - out.data());
+    if (segmentKeys) {
+        segmentKeys->resize(keys - segmentKeys->data());
+    }
+}
@@ -0,0 +1,106 @@
+#ifndef TRAIL_H
+#define TRAIL_H
+
+#include <vector>
+#include <array>
+#include <string>
+#include <cstdint>
+#include <SFML/Graphics.hpp>
+#include "gradient.h"
+#include "camera.h"
+
+// screen coordinates are stored as fixed point relative to the screen centre, at 1/8 px precision unless the
+// screen is too large for that to reach a screen's width past either edge, see TrailBuffer::setScreen
+const int TRAIL_MAX_FIXED_SHIFT = 3;
+// x of a vertex whose point was off the representable range or culled by the camera, the trail breaks there
+const int16_t TRAIL_CULLED = INT16_MIN;
+
+// trails in seconds keep a slot per frame up to the window's frame rate limit, faster frames shorten them
+const float TRAIL_MAX_FRAME_RATE = 60.0f;
+// stamps of trails in seconds are in milliseconds, limited so the oldest kept age never wraps around
+const float TRAIL_MAX_SECONDS = 60.0f;
+
+// compact trail vertex (10 bytes instead of the 20 of an sf::Vertex)
+struct TrailVertex {
+    int16_t x;
+    int16_t y;
+    int16_t depth;      // whole pixels in front of (negative) or behind the centre plane, sort keys are derived from it when expanding
+    uint16_t stamp;     // simulated frame or millisecond the vertex was recorded in, wraps around
+    uint8_t colorIndex; // index into a 256 entry gradient LUT
+};
+
+// how far back a trail reaches, in simulated frames, in seconds of frame time or in pixels along the trail on screen
+struct TrailLength {
+    enum Unit {
+        Frames,
+        Seconds,
+        Pixels
+    };
+
+    Unit unit = Frames;
+    float value = 0.0f;
+};
+
+// parses "80" (frames), "1.5s" (seconds) or "300px", false on anything else
+bool parseTrailLength(const std::string& text, TrailLength& length);
+
+// when a new vertex is recorded: the particle's head moves on screen every frame, but only becomes a fixed
+// vertex once it is spacing pixels away from the one before or turns by more than turn radians
+struct TrailSampling {
+    float spacing = 2.0f;
+    float turn = 0.2f;
+};
+
+// fixed capacity ring buffers for every particle trail, packed into one contiguous pool
+// the newest vertex of a trail always follows its particle, the ones before it are spaced out by the sampling
+class TrailBuffer {
+public:
+    explicit TrailBuffer(const TrailLength& length, const TrailSampling& sampling = TrailSampling());
+
+    void reserve(size_t trailCount);
+    void resize(size_t trailCount);
+    void shrinkToFit();
+    size_t size() const;
+    size_t length(size_t trail) const;
+    size_t vertexCount() const;
+    // upper bound of the segments expand appends, trails measured in pixels or with breaks may come out shorter
+    size_t segmentCount() const;
+
+    // picks the fixed point origin and precision for a screen size, clearing every trail when they change
+    void setScreen(float screenWidth, float screenHeight);
+    // eye distance of the plane through the attractor's centre; vertex depths are kept relative to it because the
+    // eye can be far further away than 16 bits of pixels reach, while the attractor's own depth extent is screen sized
+    void setDepthOrigin(float centreDepth);
+    // ages every trail by a frame that took frameTime seconds, trails stay as they are while the simulation is paused
+    void tick(float frameTime);
+    // a NaN or out of range position records a break, no segment is drawn to or from it
+    void push(size_t trail, float screenX, float screenY, uint8_t colorIndex, float depth);
+
+    // appends every trail to out as sf::Lines segments in one pass, fading alpha from 0 at the tail to maxAlpha at the head
+    // when segmentKeys is given it receives one 16-bit back-to-front depth key per segment, keyed in the current frame's
+    // depthRange so older vertices sort against the same scale as the points
+    void expand(const GradientLUT& lut, float maxAlpha, std::vector<sf::Vertex>& out,
+                std::vector<uint16_t>* segmentKeys = nullptr, const DepthRange* depthRange = nullptr) const;
+
+private:
+    TrailLength trailLength;
+    size_t capacity;
+    size_t trailCount;
+    uint16_t clock;         // frames, or milliseconds for trails in seconds
+    uint16_t maxAge;        // in clock units, for trails measured in frames or seconds
+    double elapsed;         // seconds of unpaused frames, for trails in seconds
+    float spacing;          // in pixels
+    float spacingSquared;   // in squared fixed point units
+    float screenWidth;
+    float screenHeight;
+    float originX;
+    float originY;
+    float depthOrigin;
+    float fixedScale;       // fixed point units per pixel
+    float minTurnCosine;
+    std::vector<TrailVertex> vertices;
+    std::vector<uint16_t> heads;
+    std::vector<uint16_t> counts;
+};
+
+#endif
@@ -0,0 +1,520 @@
+#include "trajectory.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "binary_io.h"
+#include "alloc_tracker.h"
+
+static const char MAGIC[4] = {'C', 'A', 'T', 'J'};
+static const char INDEX_MAGIC[4] = {'C', 'A', 'T', 'I'};
+static const uint16_t VERSION = 1;
+static const size_t FOOTER_SIZE = sizeof(uint64_t) + sizeof(uint32_t) + sizeof(INDEX_MAGIC);
+static const size_t CHUNK_HEADER_SIZE = 3 * sizeof(uint32_t);
+
+static const uint32_t CHUNK_FRAMES = 64;
+static const size_t BUFFER_COUNT = 3;
+static const size_t MAX_CHUNK_VALUES = 1 << 21; // 8 MB of floats per buffer
+// quantized positions are clamped so that the difference of two still fits in 32 bits
+static const float QUANTIZED_LIMIT = static_cast<float>(1 << 29);
+
+static void writeString(std::ostream& out, const std::string& text) {
+    writeBinary(out, static_cast<uint16_t>(text.size()));
+    out.write(text.data(), text.size());
+}
+
+static bool readString(std::istream& in, std::string& text) {
+    uint16_t length;
+    if (!readBinary(in, length)) {
+        return false;
+    }
+    text.resize(length);
+    return length == 0 || static_cast<bool>(in.read(&text[0], length));
+}
+
+static void putVarint(std::vector<uint8_t>& out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value) | 0x80);
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+static bool getVarint(const uint8_t*& in, const uint8_t* end, uint32_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 35 && in < end; shift += 7) {
+        uint8_t byte = *in++;
+        value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// small differences of either sign become small unsigned numbers
+static uint32_t zigzag(int32_t value) {
+    return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+}
+
+static int32_t unzigzag(uint32_t value) {
+    return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+}
+
+static int32_t quantize(float value, float step) {
+    float grid = value / step;
+    if (grid != grid) {
+        return 0;
+    }
+    return static_cast<int32_t>(std::lround(std::min(std::max(grid, -QUANTIZED_LIMIT), QUANTIZED_LIMIT)));
+}
+
+static uint32_t floatBits(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+// nearby floats share sign, exponent and the top of the mantissa, so their xor only needs its low bytes
+static int significantBytes(uint32_t bits) {
+    int bytes = 0;
+    while (bits) {
+        ++bytes;
+        bits >>= 8;
+    }
+    return bytes;
+}
+
+TrajectoryWriter::TrajectoryWriter()
+    : capturedFrames(0), exportedFrames(0), dropped(0), filling(nullptr), stopping(false) {}
+
+TrajectoryWriter::~TrajectoryWriter() {
+    close();
+}
+
+bool TrajectoryWriter::open(const std::string& path, const Scene& scene, const TrajectoryOptions& options) {
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cerr << "Error opening trajectory file " << path << std::endl;
+        return false;
+    }
+
+    header.options = options;
+    header.options.decimation = std::max(options.decimation, 1u);
+    header.instances.clear();
+    size_t frameValues = 0;
+    for (const auto& instance : scene.instances()) {
+        TrajectoryInstance description;
+        description.attractor = instance.name;
+        description.defdt = instance.attractor->defdt;
+        description.parameters = instance.attractor->parameters();
+        header.instances.push_back(description);
+        frameValues += std::max(instance.particleCount, instance.points.size()) * 3;
+    }
+
+    file.write(MAGIC, sizeof(MAGIC));
+    writeBinary(file, VERSION);
+    writeBinary(file, static_cast<uint32_t>(header.options.decimation));
+    writeBinary(file, header.options.quantization);
+    writeBinary(file, static_cast<uint16_t>(header.instances.size()));
+    for (const TrajectoryInstance& instance : header.instances) {
+        writeString(file, instance.attractor);
+        writeBinary(file, instance.defdt);
+        writeBinary(file, static_cast<uint16_t>(instance.parameters.size()));
+        for (const auto& parameter : instance.parameters) {
+            writeString(file, parameter.first);
+            writeBinary(file, parameter.second);
+        }
+    }
+
+    // every buffer is sized up front, with headroom for scenes that spawn particles
+    size_t capacity = std::max(std::min(CHUNK_FRAMES * frameValues * 5 / 4, MAX_CHUNK_VALUES), frameValues * 2);
+    size_t counts = CHUNK_FRAMES * header.instances.size();
+    for (size_t i = 0; i < BUFFER_COUNT; ++i) {
+        buffers.push_back(std::make_unique<Buffer>());
+        buffers.back()->values.reserve(capacity);
+        buffers.back()->counts.reserve(counts);
+        freeBuffers.push_back(buffers.back().get());
+    }
+    fullBuffers.reserve(BUFFER_COUNT);
+    // a varint takes at most 5 bytes per value, a float at most 4 plus a control byte per particle
+    encoded.reserve(capacity * 5 + counts * 5);
+    index.reserve(4096);
+    previousStart.assign(header.instances.size(), 0);
+    previousCount.assign(header.instances.size(), 0);
+
+    stopping = false;
+    ioThread = std::thread(&TrajectoryWriter::ioLoop, this);
+    return true;
+}
+
+bool TrajectoryWriter::isOpen() const {
+    return file.is_open();
+}
+
+uint32_t TrajectoryWriter::frameCount() const {
+    return exportedFrames;
+}
+
+uint32_t TrajectoryWriter::droppedFrames() const {
+    return dropped;
+}
+
+void TrajectoryWriter::capture(const Scene& scene) {
+    if (capturedFrames++ % header.options.decimation != 0) {
+        return;
+    }
+    uint32_t frame = exportedFrames++;
+    const std::vector<AttractorInstance>& instances = scene.instances();
+    size_t frameValues = 0;
+    for (const auto& instance : instances) {
+        frameValues += instance.points.size() * 3;
+    }
+
+    if (filling && filling->frameCount > 0 &&
+        (filling->frameCount == CHUNK_FRAMES || filling->values.size() + frameValues > filling->values.capacity())) {
+        submit();
+    }
+    if (!filling) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (freeBuffers.empty()) {
+            ++dropped;
+            return;
+        }
+        filling = freeBuffers.back();
+        freeBuffers.pop_back();
+        filling->firstFrame = frame;
+        filling->frameCount = 0;
+        filling->counts.clear();
+        filling->values.clear();
+    }
+    if (filling->values.size() + frameValues > filling->values.capacity()) {
+        // a single frame larger than a whole buffer, only when a scene keeps spawning particles
+        AllocationStage stage("export growth", true);
+        filling->values.reserve(filling->values.size() + frameValues);
+    }
+
+    for (const auto& instance : instances) {
+        const float* values = reinterpret_cast<const float*>(instance.points.data());
+        filling->counts.push_back(static_cast<uint32_t>(instance.points.size()));
+        filling->values.insert(filling->values.end(), values, values + instance.points.size() * 3);
+    }
+    ++filling->frameCount;
+}
+
+void TrajectoryWriter::submit() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        fullBuffers.push_back(filling);
+    }
+    filling = nullptr;
+    wake.notify_one();
+}
+
+void TrajectoryWriter::close() {
+    if (!file.is_open()) {
+        return;
+    }
+    if (filling && filling->frameCount > 0) {
+        submit();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    ioThread.join();
+
+    uint64_t indexOffset = static_cast<uint64_t>(file.tellp());
+    for (const TrajectoryChunk& chunk : index) {
+        writeBinary(file, chunk.offset);
+        writeBinary(file, chunk.firstFrame);
+        writeBinary(file, chunk.frameCount);
+    }
+    writeBinary(file, indexOffset);
+    writeBinary(file, static_cast<uint32_t>(index.size()));
+    file.write(INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    if (!file) {
+        std::cerr << "Error writing trajectory file" << std::endl;
+    }
+    file.close();
+}
+
+void TrajectoryWriter::ioLoop() {
+    while (true) {
+        Buffer* buffer;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stopping || !fullBuffers.empty(); });
+            if (fullBuffers.empty()) {
+                return;
+            }
+            buffer = fullBuffers.front();
+            fullBuffers.erase(fullBuffers.begin());
+        }
+
+        encode(*buffer);
+        TrajectoryChunk chunk;
+        chunk.offset = static_cast<uint64_t>(file.tellp());
+        chunk.firstFrame = buffer->firstFrame;
+        chunk.frameCount = buffer->frameCount;
+        writeBinary(file, chunk.firstFrame);
+        writeBinary(file, chunk.frameCount);
+        writeBinary(file, static_cast<uint32_t>(encoded.size()));
+        file.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+        index.push_back(chunk);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        freeBuffers.push_back(buffer);
+    }
+}
+
+// per frame and instance: particle count, then every position relative to the same particle one frame earlier
+// quantized positions are zigzag varints of the grid difference, floats are the xor with the previous bits
+// stored as their significant low bytes behind one control byte per particle
+void TrajectoryWriter::encode(const Buffer& buffer) {
+    encoded.clear();
+    const float step = header.options.quantization;
+    const size_t instanceCount = header.instances.size();
+    size_t offset = 0;
+    for (uint32_t frame = 0; frame < buffer.frameCount; ++frame) {
+        for (size_t i = 0; i < instanceCount; ++i) {
+            uint32_t count = buffer.counts[frame * instanceCount + i];
+            const float* current = buffer.values.data() + offset;
+            const float* previous = buffer.values.data() + previousStart[i];
+            size_t previousParticles = frame == 0 ? 0 : previousCount[i];
+            putVarint(encoded, count);
+
+            for (uint32_t p = 0; p < count; ++p) {
+                bool predicted = p < previousParticles;
+                if (step > 0.0f) {
+                    for (int c = 0; c < 3; ++c) {
+                        int32_t base = predicted ? quantize(previous[p * 3 + c], step) : 0;
+                        putVarint(encoded, zigzag(quantize(current[p * 3 + c], step) - base));
+                    }
+                } else {
+                    uint32_t deltas[3];
+                    int control = 0;
+                    for (int c = 0, weight = 1; c < 3; ++c, weight *= 5) {
+                        uint32_t base = predicted ? floatBits(previous[p * 3 + c]) : 0;
+                        deltas[c] = floatBits(current[p * 3 + c]) ^ base;
+                        control += significantBytes(deltas[c]) * weight;
+                    }
+                    encoded.push_back(static_cast<uint8_t>(control));
+                    for (int c = 0; c < 3; ++c) {
+                        for (uint32_t bits = deltas[c]; bits; bits >>= 8) {
+                            encoded.push_back(static_cast<uint8_t>(bits));
+                        }
+                    }
+                }
+            }
+            previousStart[i] = offset;
+            previousCount[i] = count;
+            offset += count * 3;
+        }
+    }
+}
+
+TrajectoryReader::TrajectoryReader() : cachedChunk(SIZE_MAX) {}
+
+const TrajectoryHeader& TrajectoryReader::header() const {
+    return fileHeader;
+}
+
+const std::vector<TrajectoryChunk>& TrajectoryReader::chunks() const {
+    return index;
+}
+
+uint32_t TrajectoryReader::frameCount() const {
+    return index.empty() ? 0 : index.back().firstFrame + index.back().frameCount;
+}
+
+bool TrajectoryReader::open(const std::string& path) {
+    file.open(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Error opening trajectory file " << path << std::endl;
+        return false;
+    }
+
+    char magic[sizeof(MAGIC)];
+    uint16_t version;
+    if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || !readBinary(file, version)) {
+        std::cerr << path << " is not a trajectory file" << std::endl;
+        return false;
+    }
+    if (version != VERSION) {
+        std::cerr << path << ": unsupported trajectory version " << version << std::endl;
+        return false;
+    }
+    uint32_t decimation;
+    uint16_t instanceCount;
+    bool complete = readBinary(file, decimation) && readBinary(file, fileHeader.options.quantization) &&
+                    readBinary(file, instanceCount);
+    fileHeader.options.decimation = decimation;
+    fileHeader.instances.clear();
+    for (uint16_t i = 0; complete && i < instanceCount; ++i) {
+        TrajectoryInstance instance;
+        uint16_t parameterCount;
+        complete = readString(file, instance.attractor) && readBinary(file, instance.defdt) &&
+                   readBinary(file, parameterCount);
+        for (uint16_t p = 0; complete && p < parameterCount; ++p) {
+            std::pair<std::string, float> parameter;
+            complete = readString(file, parameter.first) && readBinary(file, parameter.second);
+            instance.parameters.push_back(parameter);
+        }
+        fileHeader.instances.push_back(instance);
+    }
+    if (!complete) {
+        std::cerr << path << ": truncated header" << std::endl;
+        return false;
+    }
+    uint64_t chunksStart = static_cast<uint64_t>(file.tellg());
+
+    // the footer points at the index, without one the chunks are walked from the start
+    file.seekg(0, std::ios::end);
+    uint64_t size = static_cast<uint64_t>(file.tellg());
+    index.clear();
+    cachedChunk = SIZE_MAX;
+    if (size >= chunksStart + FOOTER_SIZE) {
+        uint64_t indexOffset;
+        uint32_t chunkCount;
+        char indexMagic[sizeof(INDEX_MAGIC)];
+        file.seekg(size - FOOTER_SIZE);
+        if (readBinary(file, indexOffset) && readBinary(file, chunkCount) && file.read(indexMagic, sizeof(indexMagic)) &&
+            std::memcmp(indexMagic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0 &&
+            indexOffset + static_cast<uint64_t>(chunkCount) * 16 + FOOTER_SIZE == size) {
+            file.seekg(indexOffset);
+            index.resize(chunkCount);
+            for (TrajectoryChunk& chunk : index) {
+                readBinary(file, chunk.offset);
+                readBinary(file, chunk.firstFrame);
+                readBinary(file, chunk.frameCount);
+            }
+            if (file) {
+                return true;
+            }
+            file.clear();
+            index.clear();
+        }
+    }
+    file.clear();
+    std::cerr << path << ": no index, scanning chunks" << std::endl;
+    return scanChunks(chunksStart);
+}
+
+bool TrajectoryReader::scanChunks(uint64_t start) {
+    file.seekg(0, std::ios::end);
+    uint64_t size = static_cast<uint64_t>(file.tellg());
+    uint64_t offset = start;
+    while (offset + CHUNK_HEADER_SIZE <= size) {
+        TrajectoryChunk chunk;
+        uint32_t payloadSize;
+        file.seekg(offset);
+        if (!readBinary(file, chunk.firstFrame) || !readBinary(file, chunk.frameCount) || !readBinary(file, payloadSize) ||
+            offset + CHUNK_HEADER_SIZE + payloadSize > size) {
+            break; // cut off mid chunk
+        }
+        chunk.offset = offset;
+        index.push_back(chunk);
+        offset += CHUNK_HEADER_SIZE + payloadSize;
+    }
+    file.clear();
+    return true;
+}
+
+bool TrajectoryReader::loadChunk(size_t chunk) {
+    if (chunk == cachedChunk) {
+        return true;
+    }
+    const TrajectoryChunk& entry = index[chunk];
+    uint32_t firstFrame, frames, payloadSize;
+    file.seekg(entry.offset);
+    if (!readBinary(file, firstFrame) || !readBinary(file, frames) || !readBinary(file, payloadSize)) {
+        file.clear();
+        std::cerr << "Error reading trajectory chunk " << chunk << std::endl;
+        return false;
+    }
+    payload.resize(payloadSize);
+    if (payloadSize > 0 && !file.read(reinterpret_cast<char*>(payload.data()), payloadSize)) {
+        file.clear();
+        std::cerr << "Error reading trajectory chunk " << chunk << std::endl;
+        return false;
+    }
+
+    const float step = fileHeader.options.quantization;
+    const size_t instanceCount = fileHeader.instances.size();
+    const uint8_t* in = payload.data();
+    const uint8_t* end = in + payload.size();
+    std::vector<std::vector<int32_t>> previousGrid(instanceCount);
+    cachedChunk = SIZE_MAX;
+    cachedFrames.resize(frames);
+    for (uint32_t frame = 0; frame < frames; ++frame) {
+        cachedFrames[frame].resize(instanceCount);
+        for (size_t i = 0; i < instanceCount; ++i) {
+            TrajectoryPositions& positions = cachedFrames[frame][i];
+            const TrajectoryPositions* previous = frame == 0 ? nullptr : &cachedFrames[frame - 1][i];
+            uint32_t count;
+            if (!getVarint(in, end, count) || count > static_cast<size_t>(end - in)) {
+                std::cerr << "Corrupt trajectory chunk " << chunk << std::endl;
+                return false;
+            }
+            positions.resize(count);
+            std::vector<int32_t>& grid = previousGrid[i];
+            size_t previousParticles = previous ? previous->size() : 0;
+            grid.resize(std::max<size_t>(grid.size(), count * 3), 0);
+
+            for (uint32_t p = 0; p < count; ++p) {
+                bool predicted = p < previousParticles;
+                if (step > 0.0f) {
+                    for (int c = 0; c < 3; ++c) {
+                        uint32_t delta;
+                        if (!getVarint(in, end, delta)) {
+                            std::cerr << "Corrupt trajectory chunk " << chunk << std::endl;
+                            return false;
+                        }
+                        int32_t value = (predicted ? grid[p * 3 + c] : 0) + unzigzag(delta);
+                        grid[p * 3 + c] = value;
+                        positions[p][c] = value * step;
+                    }
+                } else {
+                    if (in >= end) {
+                        std::cerr << "Corrupt trajectory chunk " << chunk << std::endl;
+                        return false;
+                    }
+                    int control = *in++;
+                    for (int c = 0; c < 3; ++c, control /= 5) {
+                        int bytes = control % 5;
+                        if (bytes > end - in) {
+                            std::cerr << "Corrupt trajectory chunk " << chunk << std::endl;
+                            return false;
+                        }
+                        uint32_t bits = 0;
+                        for (int b = 0; b < bytes; ++b) {
+                            bits |= static_cast<uint32_t>(*in++) << (8 * b);
+                        }
+                        if (predicted) {
+                            bits ^= floatBits((*previous)[p][c]);
+                        }
+                        std::memcpy(&positions[p][c], &bits, sizeof(bits));
+                    }
+                }
+            }
+        }
+    }
+    cachedChunk = chunk;
+    return true;
+}
+
+bool TrajectoryReader::readFrame(uint32_t frame, std::vector<TrajectoryPositions>& instances) {
+    auto next = std::upper_bound(index.begin(), index.end(), frame,
+                                 [](uint32_t value, const TrajectoryChunk& chunk) { return value < chunk.firstFrame; });
+    if (next == index.begin()) {
+        return false;
+    }
+    size_t chunk = static_cast<size_t>(next - index.begin()) - 1;
+    if (frame >= index[chunk].firstFrame + index[chunk].frameCount || !loadChunk(chunk)) {
+        return false;
+    }
+    instances = cachedFrames[frame - index[chunk].firstFrame];
+    return true;
+}
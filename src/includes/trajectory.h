@@ -0,0 +1,127 @@
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <string>
+#include <vector>
+#include <array>
+#include <memory>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include "scene.h"
+
+// chunked trajectory files, written in host byte order
+//   header: magic, version, decimation, quantization step, then per instance the attractor name,
+//           its default timestep and its parameters
+//   chunks: first frame, frame count, payload size, payload
+//   index:  file offset, first frame and frame count of every chunk
+//   footer: index offset, chunk count, magic
+// a chunk's first frame holds absolute positions and later frames the change from the frame before,
+// so every chunk decodes on its own and the index gives random access to any frame
+
+struct TrajectoryInstance {
+    std::string attractor;
+    float defdt = 0.0f;
+    std::vector<std::pair<std::string, float>> parameters;
+};
+
+struct TrajectoryOptions {
+    unsigned decimation = 1;   // keep every n-th frame
+    float quantization = 0.0f; // grid step in attractor units, 0 keeps full precision floats
+};
+
+struct TrajectoryHeader {
+    TrajectoryOptions options;
+    std::vector<TrajectoryInstance> instances;
+};
+
+struct TrajectoryChunk {
+    uint64_t offset;
+    uint32_t firstFrame;
+    uint32_t frameCount;
+};
+
+// positions of every particle of one instance in one frame
+typedef std::vector<std::array<float, 3>> TrajectoryPositions;
+
+// streams particle positions to disk without ever blocking the frame
+// the frame thread only copies positions into one of a few preallocated chunk buffers, a background thread
+// compresses and writes full chunks; if the disk falls behind and no buffer is free the frame is dropped
+class TrajectoryWriter {
+public:
+    TrajectoryWriter();
+    ~TrajectoryWriter();
+
+    bool open(const std::string& path, const Scene& scene, const TrajectoryOptions& options);
+    bool isOpen() const;
+    void capture(const Scene& scene);
+    // flushes the last chunk, waits for the writes and appends the index
+    void close();
+    uint32_t frameCount() const;
+    uint32_t droppedFrames() const;
+
+private:
+    struct Buffer {
+        uint32_t firstFrame;
+        uint32_t frameCount;
+        std::vector<uint32_t> counts; // per frame and instance
+        std::vector<float> values;
+    };
+
+    std::ofstream file;
+    TrajectoryHeader header;
+    uint32_t capturedFrames;
+    uint32_t exportedFrames;
+    uint32_t dropped;
+    std::vector<std::unique_ptr<Buffer>> buffers;
+    Buffer* filling;
+
+    // shared with the I/O thread
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<Buffer*> freeBuffers;
+    std::vector<Buffer*> fullBuffers; // oldest first
+    bool stopping;
+
+    // owned by the I/O thread until it is joined
+    std::thread ioThread;
+    std::vector<uint8_t> encoded;
+    std::vector<TrajectoryChunk> index;
+    std::vector<size_t> previousStart; // per instance, where its previous frame starts in the buffer
+    std::vector<size_t> previousCount;
+
+    void submit();
+    void ioLoop();
+    void encode(const Buffer& buffer);
+};
+
+// random access to the frames of a trajectory file
+class TrajectoryReader {
+public:
+    TrajectoryReader();
+
+    // reports problems on std::cerr; a file without an index, e.g. from a crashed capture, is scanned chunk by chunk
+    bool open(const std::string& path);
+    const TrajectoryHeader& header() const;
+    const std::vector<TrajectoryChunk>& chunks() const;
+    // one past the last frame, frames dropped while writing leave gaps
+    uint32_t frameCount() const;
+    // false if the frame was dropped or is outside the file
+    bool readFrame(uint32_t frame, std::vector<TrajectoryPositions>& instances);
+
+private:
+    std::ifstream file;
+    TrajectoryHeader fileHeader;
+    std::vector<TrajectoryChunk> index;
+    // the most recently decoded chunk, sequential reads mostly hit it
+    size_t cachedChunk;
+    std::vector<std::vector<TrajectoryPositions>> cachedFrames;
+    std::vector<uint8_t> payload;
+
+    bool scanChunks(uint64_t start);
+    bool loadChunk(size_t chunk);
+};
+
+#endif
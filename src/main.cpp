@@ -5,101 +5,48 @@
 #include <cmath>
 #include <random>
 #include <filesystem>
-#include "includes/matrix.h"
+#include <chrono>
+#include "includes/trail.h"
+#include "includes/gradient.h"
+#include "includes/camera.h"
+#include "includes/jobs.h"
+#include "includes/scene.h"
+#include "includes/audio_player.h"
+#include "includes/startup_report.h"
+#include "includes/batch.h"
+#include "includes/alloc_tracker.h"
+#include "includes/session.h"
+#include "includes/renderer.h"
+#include "includes/software_renderer.h"
+#include "includes/trajectory.h"
+#include "includes/publisher.h"
+#include "includes/density.h"
 #include "includes/attractors/attractors.h"
 #include "includes/attractors/base_attractor.h"
 #include <string>
-
-
-class AudioPlayer {
-public:
-    AudioPlayer() : sound(), buffer(), samples(), sampleRate(0), currentAmplitude(0.0f) {}
-
-    bool loadAndPlay(const std::string& path) {
-        std::__fs::filesystem::path fsPath(path);
-        if (fsPath.extension() == ".mp3") {
-            if (buffer.loadFromFile(fsPath.string())) {
-                samples = buffer.getSamples();
-                sampleRate = buffer.getSampleRate();
-                sound.setBuffer(buffer);
-                sound.play();
-                songTitle = fsPath.filename().string();
-                computeMaxAmplitude();
-                return true;
-            }
-        }
-        return false;
-    }
-
-    float getAmplitude() {
-        size_t sampleCount = buffer.getSampleCount();
-        if (sampleCount == 0) return 0.0f;
-
-        float amplitudeSum = 0.0f;
-        size_t samplePos = sound.getPlayingOffset().asSeconds() * sampleRate * 2; // 2 channels (stereo)
-
-        for (size_t i = samplePos; i < samplePos + 2048 && i < sampleCount; ++i) {
-            amplitudeSum += std::abs(samples[i]);
-        }
-
-        float amplitude = amplitudeSum / 2048.0f;
-        currentAmplitude = amplitude;
-        return amplitude;
-    }
-
-    float getCurrentAmplitude() const {
-        return currentAmplitude;
-    }
-
-    const std::string& getSongTitle() const {
-        return songTitle;
-    }
-
-    float getMaxAmplitude() const {
-        return maxAmplitude;
-    }
-
-    sf::Sound sound;
-
-private:
-    sf::SoundBuffer buffer;
-    const sf::Int16* samples;
-    unsigned int sampleRate;
-    float currentAmplitude;
-    std::string songTitle;
-    float maxAmplitude;
-
-    void computeMaxAmplitude() {
-        float maxAmplitude = 0.0f;
-
-        size_t sampleCount = buffer.getSampleCount();
-
-        for (size_t i = 0; i < sampleCount; ++i) {
-            float absSample = std::abs(samples[i]);
-            if (absSample > maxAmplitude) {
-                maxAmplitude = absSample;
-            }
-        }
-    }
+#include <limits>
+#include <algorithm>
+#include <iomanip>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <cctype>
+
+
+// optional per-frame outputs next to the window, any of them may be null
+struct FrameOutputs {
+    SessionRecorder* recorder = nullptr;
+    TrajectoryWriter* exporter = nullptr;
+    SharedStatePublisher* publisher = nullptr;
 };
 
 class Visualization {
 public:
-    Visualization(int width, int height, const std::string& title, AudioPlayer& audioPlayer, const Attractor& attractor)
-        : window(sf::VideoMode::getFullscreenModes()[0], title, sf::Style::Fullscreen),
-          scale(attractor.scale),
-          offsetX(attractor.offsetX),
-          offsetY(attractor.offsetY),
-          angles(attractor.angles),
-          offsetYs(attractor.offsetYs),
-          rotationX(attractor.angles[0][0]),
-          rotationY(attractor.angles[0][1]),
-          rotationZ(attractor.angles[0][2]),
+    Visualization(const sf::VideoMode& mode, const std::string& title, AudioPlayer& audioPlayer, Scene& scene, JobSystem& jobs, StartupReport& report, Renderer& renderer, const FrameOutputs& outputs = FrameOutputs())
+        : window(mode, title, sf::Style::Fullscreen),
           audioPlayer(audioPlayer),
-          xyswap(attractor.xyswap),
           isTransitioning(false), transitionFrames(0),
-          attractor(attractor),
-          randrange(attractor.randrange),
+          scene(scene),
           spacepress(false),
           tailon(true),
           menu(true),
@@ -108,11 +55,19 @@ public:
           tailtoggle(true),
           SCROLL_WAIT_TIME(0.4f),
           MOUSE_WAIT_TIME(0.5f),
-          ARROW_KEY_WAIT_TIME(0.4f) {
-
+          ARROW_KEY_WAIT_TIME(0.4f),
+          batch(jobs),
+          additiveBlend(false),
+          report(report),
+          renderer(renderer),
+          outputs(outputs) {
+
+            report.end("window");
+            report.begin("font");
             if (!font.loadFromFile("font/RobotoMono-Regular.ttf")) {
                 std::cerr << "Error loading font" << std::endl;
             }
+            report.end("font");
             titletext.setFont(font);
             titletext.setCharacterSize(15);
             titletext.setFillColor(sf::Color::White);
@@ -123,6 +78,7 @@ public:
             songTitleText.setCharacterSize(15);
             songTitleText.setFillColor(sf::Color::White);
             songTitleText.setPosition(10.f, window.getSize().y - 150.0f);
+            songTitleText.setString("Song: ");
 
             angleTextX.setFont(font);
             angleTextX.setCharacterSize(15);
@@ -153,96 +109,103 @@ public:
             commandsText.setCharacterSize(15);
             commandsText.setFillColor(sf::Color::White);
             commandsText.setPosition(10.f, window.getSize().y - 30.0f);
-            commandsText.setString("Commands: Mouse Drag(rotate along axes), T(toggle tails), Arrow Keys(change screen offset), Scroll(Change scale), Space(pause), R(reset), M(toggle menu), Q(quit)");
+            allocationText.setFont(font);
+            allocationText.setCharacterSize(15);
+            allocationText.setFillColor(sf::Color::White);
+            allocationText.setPosition(10.f, window.getSize().y - 190.0f);
+
+            commandsText.setString("Commands: Mouse Drag(rotate along axes), T(toggle tails), Arrow Keys(change screen offset), Scroll(Change scale), Space(pause), R(reset), M(toggle menu), C(color mode), P(perspective), [ ](field of view), -/=(camera distance), B(additive blend), Q(quit)");
 
             window.setFramerateLimit(60);
         }
 
-    void run(const Attractor& attractor) {
-        std::vector<std::vector<float>> points = initializePoints();
-        std::vector<std::vector<sf::Vertex>> trails(points.size());
-        const size_t maxTrailSize = 80;
-        if(dynamic_cast<const AizawaAttractor*>(&attractor)){
-            const size_t maxTrailSize = 30;
-        } else if(dynamic_cast<const SprottAttractor*>(&attractor)){
-            const size_t maxTrailSize = 800;
-        } else if(dynamic_cast<const LorenzAttractor*>(&attractor)){
-            const size_t maxTrailSize = 20;
-        } else{
-            const size_t maxTrailSize = 40;
+    void run() {
+        report.begin("first frame");
+        unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
+        scene.initializePoints(seed);
+        if (outputs.recorder) {
+            outputs.recorder->begin(seed, window.getSize().x, window.getSize().y);
         }
+        // the lens may come from the command line, going through input puts it into recordings
+        input(makeLensInput(scene.fov, scene.eyeDistance));
+        bool firstFrame = true;
+        sf::Clock frameClock;
         while (window.isOpen()) {
+            FrameAllocations& allocations = frameAllocations();
+            allocations.beginFrame();
             handleEvents();
-            float amplitude = audioPlayer.getAmplitude();
-            if(amplitude > 800.0f){
-                amplitude = 800.0f;
+            {
+                // visuals run silently until the background decode finishes
+                // the stream doesn't move while paused, so the last levels still hold
+                AllocationStage stage("audio");
+                audioPlayer.poll();
+                if (!spacepress || firstFrame) {
+                    levels = audioPlayer.getLevels();
+                }
+            }
+            // measured rather than assumed, trails in seconds stay that long when frames come slower than the limit
+            float frameTime = frameClock.restart().asSeconds();
+            if (outputs.recorder) {
+                outputs.recorder->frame(levels, tailon, frameTime);
+            }
+            {
+                AllocationStage stage("simulate");
+                scene.update(levels, spacepress, view, window.getSize().x, window.getSize().y, frameTime);
             }
-            std::unique_ptr<Attractor> adjustedattractor;
-            if(!spacepress){
-                if (dynamic_cast<const LorenzAttractor*>(&attractor)) {
-                    float speedFactor = attractor.speedfactor(attractor.defdt, amplitude);
-                    if(speedFactor > 0.008f){
-                        speedFactor = 0.008f;
-                    }
-                    adjustedattractor = std::make_unique<LorenzAttractor>(speedFactor);
-                } else if (dynamic_cast<const AizawaAttractor*>(&attractor)) {
-                    float speedFactor = attractor.speedfactor(attractor.defdt, amplitude);
-                    if(speedFactor > 0.1f){
-                        speedFactor = 0.1f;
-                    }
-                    adjustedattractor = std::make_unique<AizawaAttractor>(speedFactor);
-                } else if(dynamic_cast<const ThomasAttractor*>(&attractor)){
-                    float speedFactor = attractor.speedfactor(attractor.defdt, amplitude);
-                    if(speedFactor > 0.3f){
-                        speedFactor = 0.3f;
-                    }
-                    std::cout << speedFactor << std::endl;
-                    adjustedattractor = std::make_unique<ThomasAttractor>(speedFactor);
-                } else if(dynamic_cast<const HalvorsenAttractor*>(&attractor)){
-                    float speedFactor = attractor.speedfactor(attractor.defdt, amplitude);
-                    if(speedFactor > 0.3f){
-                        speedFactor = 0.3f;
-                    }
-                    adjustedattractor = std::make_unique<HalvorsenAttractor>(speedFactor);
-                } else if(dynamic_cast<const SprottAttractor*>(&attractor)){
-                    float speedFactor = attractor.speedfactor(attractor.defdt, amplitude);
-                    if(speedFactor > 0.1f){
-                        speedFactor = 0.1f;
-                    }
-                    adjustedattractor = std::make_unique<SprottAttractor>(speedFactor);
+            if (outputs.exporter) {
+                AllocationStage stage("export");
+                outputs.exporter->capture(scene);
+            }
+            if (outputs.publisher) {
+                AllocationStage stage("publish");
+                outputs.publisher->publish(scene, levels, window.getSize().x, window.getSize().y);
+            }
+            render();
+            if (firstFrame) {
+                report.end("first frame");
+                firstFrame = false;
+            }
+            report.printWhenComplete(std::cout);
+
+            {
+                AllocationStage stage("hud");
+                // the stats menu follows the first attractor of the scene
+                const AttractorInstance& primary = scene.instances().front();
+                // sf::Text rebuilds its glyphs on every setString, so the stats are only formatted again when they change
+                if (hudChanged(hud.songTitle, audioPlayer.getSongTitle())) {
+                    songTitleText.setString("Song: " + hud.songTitle);
+                }
+                if (hudChanged(hud.rotationX, primary.rotation[0] + view.rotationX)) {
+                    angleTextX.setString("Rotation along X-Axis: " + std::to_string(hud.rotationX));
+                }
+                if (hudChanged(hud.rotationY, primary.rotation[1] + view.rotationY)) {
+                    angleTextY.setString("Rotation along Y-Axis: " + std::to_string(hud.rotationY));
+                }
+                bool offsetXChanged = hudChanged(hud.offsetX, primary.offsetX + view.offsetX);
+                if (hudChanged(hud.offsetY, primary.offsetY + view.offsetY) || offsetXChanged) {
+                    offsetText.setString("OffsetX: " + std::to_string(hud.offsetX) + " OffsetY: " + std::to_string(hud.offsetY));
                 }
-            }else{
-                if (dynamic_cast<const LorenzAttractor*>(&attractor)) {
-                    adjustedattractor = std::make_unique<LorenzAttractor>(0.0f);
-                } else if (dynamic_cast<const AizawaAttractor*>(&attractor)) {
-                    adjustedattractor = std::make_unique<AizawaAttractor>(0.0f);
-                } else if(dynamic_cast<const ThomasAttractor*>(&attractor)){
-                    adjustedattractor = std::make_unique<ThomasAttractor>(0.0f);
-                } else if(dynamic_cast<const HalvorsenAttractor*>(&attractor)){
-                    adjustedattractor = std::make_unique<HalvorsenAttractor>(0.0f);
-                } else if(dynamic_cast<const SprottAttractor*>(&attractor)){
-                    adjustedattractor = std::make_unique<SprottAttractor>(0.0f);
+                if (hudChanged(hud.scale, primary.scale * view.zoom)) {
+                    scaleText.setString("Scale: " + std::to_string(hud.scale));
+                }
+                // only two decimals are shown, so the amplitude is cut to those before comparing
+                float amplitude = std::floor(primary.normalizedAmplitude(levels) * 100.0f) / 100.0f;
+                if (hudChanged(hud.amplitude, amplitude)) {
+                    amplitudeText.setString("Normalized Amplitude: " + std::to_string(hud.amplitude).substr(0, 4));
+                }
+                if (ALLOCATION_TRACKING) {
+                    allocationText.setString(describeAllocations(allocations));
                 }
             }
-            updatePoints(*adjustedattractor, points, trails, maxTrailSize);
-            render(points, trails);
-
-            songTitleText.setString("Song: " + audioPlayer.getSongTitle());
-            angleTextX.setString("Rotation along X-Axis: " + std::to_string(rotationX));
-            angleTextY.setString("Rotation along Y-Axis: " + std::to_string(rotationY));
-            offsetText.setString("OffsetX: " + std::to_string(offsetX) + " OffsetY: " + std::to_string(offsetY));
-            scaleText.setString("Scale: " + std::to_string(scale));
-            amplitudeText.setString("Normalized Amplitude: " + std::to_string(std::min(audioPlayer.getCurrentAmplitude() / attractor.maxamplitude, 1.0f)).substr(0, 4));
+            allocations.endFrame();
+        }
+        if (outputs.recorder) {
+            outputs.recorder->close(outputHash(scene, batch));
         }
     }
 
 private:
     sf::RenderWindow window;
-    float scale;
-    float offsetX, offsetY;
-    float angle;
-    std::vector<std::array<float, 3>> angles;
-    std::array<float, 4> offsetYs;
     AudioPlayer& audioPlayer;
     sf::Font font;
     sf::Text titletext;
@@ -255,14 +218,11 @@ private:
     sf::Text offsetText;
     bool isTransitioning;
     int transitionFrames;
-    bool xyswap;
-    const Attractor& attractor;
-    float randrange;
+    Scene& scene;
+    ViewState view;
     bool spacepress;
     bool tailon;
     bool menu;
-    int counter = 0;
-    float rotationX, rotationY, rotationZ;
     bool isDragging;
     sf::Vector2i lastMousePos;
     bool tailtoggle;
@@ -274,56 +234,31 @@ private:
     const float MOUSE_WAIT_TIME;
     sf::Clock arrowKeyTimer;
     const float ARROW_KEY_WAIT_TIME;
-
-    std::vector<std::vector<float>> initializePoints() {
-        std::vector<std::vector<float>> points;
-        unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
-        std::default_random_engine generator(seed);
-        std::uniform_real_distribution<float> distribution(-randrange, randrange);
-        
-        if (dynamic_cast<const LorenzAttractor*>(&attractor)) {
-            for (int i = 0; i < 1000; ++i) {
-                float x = (i < 500) ? -0.1f : 0.1f;
-                points.push_back({
-                    x + distribution(generator) * 0.01f,
-                    distribution(generator),
-                    distribution(generator)
-                });
-            }
-        } else if(dynamic_cast<const AizawaAttractor*>(&attractor)){
-            for (int i = 0; i < 200; ++i) {
-                points.push_back({
-                    distribution(generator),
-                    distribution(generator),
-                    distribution(generator)
-                });
-            }
-        } else if(dynamic_cast<const ThomasAttractor*>(&attractor)){
-            for (int i = 0; i < 800; ++i) {
-                points.push_back({
-                    distribution(generator),
-                    distribution(generator),
-                    distribution(generator)
-                });
-            }
-        } else if(dynamic_cast<const HalvorsenAttractor*>(&attractor)){
-            for (int i = 0; i < 800; ++i) {
-                points.push_back({
-                    distribution(generator),
-                    distribution(generator),
-                    distribution(generator)
-                });
-            }
-        } else if(dynamic_cast<const SprottAttractor*>(&attractor)){
-            for (int i = 0; i < 800; ++i) {
-                points.push_back({
-                    distribution(generator),
-                    distribution(generator),
-                    distribution(generator)
-                });
-            }
+    DrawBatch batch;
+    bool additiveBlend;
+    sf::Text allocationText;
+    // values the stats menu shows right now, NaN until the first frame so everything is formatted once
+    struct HudValues {
+        std::string songTitle;
+        float rotationX = std::numeric_limits<float>::quiet_NaN();
+        float rotationY = std::numeric_limits<float>::quiet_NaN();
+        float offsetX = std::numeric_limits<float>::quiet_NaN();
+        float offsetY = std::numeric_limits<float>::quiet_NaN();
+        float scale = std::numeric_limits<float>::quiet_NaN();
+        float amplitude = std::numeric_limits<float>::quiet_NaN();
+    } hud;
+    AudioLevels levels;
+    StartupReport& report;
+    Renderer& renderer;
+    FrameOutputs outputs;
+
+    template <typename T>
+    static bool hudChanged(T& shown, const T& value) {
+        if (shown == value) {
+            return false;
         }
-        return points;
+        shown = value;
+        return true;
     }
 
     bool isAngleInList(float value, const std::array<float, 4> list) {
@@ -335,6 +270,17 @@ private:
         return false;
     }
 
+    // everything that affects the simulation or the batch goes through here so sessions can record it
+    void input(const InputEvent& event) {
+        applyInput(event, view, spacepress, additiveBlend, scene);
+        if (event.kind == InputKind::Pause) {
+            audioPlayer.setPaused(spacepress);
+        }
+        if (outputs.recorder) {
+            outputs.recorder->input(event);
+        }
+    }
+
     void handleEvents() {
         sf::Event event;
         static bool isScrolled = false;
@@ -363,8 +309,7 @@ private:
                     sf::Vector2i currentMousePos = sf::Mouse::getPosition(window);
                     sf::Vector2i delta = currentMousePos - lastMousePos;
 
-                    rotationX -= delta.y * 0.006f;
-                    rotationY -= delta.x * 0.006f;
+                    input(makeInput(InputKind::Rotate, delta.x, delta.y));
 
                     lastMousePos = currentMousePos;
                     tailon = false;
@@ -374,12 +319,7 @@ private:
                 }
             } else if (event.type == sf::Event::MouseWheelScrolled) {
                 if (event.mouseWheelScroll.wheel == sf::Mouse::VerticalWheel) {
-                    float zoomFactor = 1.1f;
-                    if (event.mouseWheelScroll.delta > 0) {
-                        scale *= zoomFactor;
-                    } else {
-                        scale /= zoomFactor;
-                    }
+                    input(makeInput(InputKind::Zoom, event.mouseWheelScroll.delta > 0 ? 1 : -1));
                     tailon = false;
                     isScrolled = true;
                     isWaitingAfterScroll = false;
@@ -387,48 +327,49 @@ private:
                 }
             } else if (event.type == sf::Event::KeyPressed) {
                 if(event.key.code == sf::Keyboard::Space){
-                    if(!spacepress){
-                        spacepress = true;
-                        audioPlayer.sound.pause();
-                    }else{
-                        spacepress = false;
-                        audioPlayer.sound.play();
-                    }
+                    input(makeInput(InputKind::Pause));
                 } else if(event.key.code == sf::Keyboard::T){
                     tailon = !tailon;
                     tailtoggle = tailon;
                 } else if(event.key.code == sf::Keyboard::Right)
                 {
-                    offsetX += 10.0f;
+                    input(makeInput(InputKind::Pan, 1, 0));
                     tailon = false;
                     isArrowKeyPressed = true;
                     arrowKeyTimer.restart();
                 } else if(event.key.code == sf::Keyboard::Left)
                 {
-                    offsetX -= 10.0f;
+                    input(makeInput(InputKind::Pan, -1, 0));
                     tailon = false;
                     isArrowKeyPressed = true;
                     arrowKeyTimer.restart();
                 }else if(event.key.code == sf::Keyboard::Up)
                 {
-                    offsetY += 10.0f;
+                    input(makeInput(InputKind::Pan, 0, 1));
                     tailon = false;
                     isArrowKeyPressed = true;
                     arrowKeyTimer.restart();
                 }else if(event.key.code == sf::Keyboard::Down)
                 {
-                    offsetY -= 10.0f;
+                    input(makeInput(InputKind::Pan, 0, -1));
                     tailon = false;
                     isArrowKeyPressed = true;
                     arrowKeyTimer.restart();
                 } else if(event.key.code == sf::Keyboard::R){
-                    rotationX = angles[0][0];
-                    rotationY = angles[0][1];
-                    offsetX = attractor.offsetX;
-                    offsetY = attractor.offsetY;
-                    scale = attractor.scale;
+                    input(makeInput(InputKind::Reset));
                 } else if(event.key.code == sf::Keyboard::M){
                     menu = !menu;
+                } else if(event.key.code == sf::Keyboard::C){
+                    input(makeInput(InputKind::ColorMode));
+                } else if(event.key.code == sf::Keyboard::P){
+                    input(makeInput(InputKind::Projection));
+                } else if(event.key.code == sf::Keyboard::B){
+                    input(makeInput(InputKind::Blend));
+                } else if(event.key.code == sf::Keyboard::LBracket || event.key.code == sf::Keyboard::RBracket){
+                    float step = 5.0f * static_cast<float>(M_PI) / 180.0f;
+                    input(makeLensInput(scene.fov + (event.key.code == sf::Keyboard::LBracket ? -step : step), scene.eyeDistance));
+                } else if(event.key.code == sf::Keyboard::Hyphen || event.key.code == sf::Keyboard::Equal){
+                    input(makeLensInput(scene.fov, scene.eyeDistance * (event.key.code == sf::Keyboard::Hyphen ? 1.0f / 1.1f : 1.1f)));
                 }
             }
         }
@@ -467,126 +408,7 @@ private:
         }
     }
 
-    void updatePoints(const Attractor& attractor, std::vector<std::vector<float>>& points, std::vector<std::vector<sf::Vertex>>& trails, size_t maxTrailSize) {
-        if (dynamic_cast<const AizawaAttractor*>(&attractor)) {
-            const size_t REALLOC_THRESHOLD = 1000; // threshold for reallocation
-            const size_t REALLOC_INCREASE = 500;   // number of new elements to add during reallocation
-            counter = (counter + 1) % 40;
-            if(counter%40 == 0){
-                unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
-                std::default_random_engine generator(seed);
-                std::uniform_real_distribution<float> distribution(-10 * randrange, 10 * randrange);
-                
-                // check if we need to reallocate
-                if (points.size() + 10 > points.capacity()) {
-                    size_t newCapacity = points.capacity() + REALLOC_INCREASE;
-                    points.reserve(newCapacity);
-                    trails.reserve(newCapacity);
-                }
-                for (int i = 0; i < 10; ++i) {
-                    points.push_back({
-                        distribution(generator),
-                        distribution(generator),
-                        distribution(generator)
-                    });
-                    trails.push_back(std::vector<sf::Vertex>());
-                }
-            }
-
-            // periodically remove excess capacity to save memory
-            if (points.size() > REALLOC_THRESHOLD && points.capacity() - points.size() > REALLOC_INCREASE) {
-                std::vector<std::vector<float>> temp_points(points.begin(), points.end());
-                points.swap(temp_points); // swap points with temp_points which has no extra memory allocation
-
-                std::vector<std::vector<sf::Vertex>> temp_trails(trails.begin(), trails.end());
-                trails.swap(temp_trails);
-            }
-        }
-
-        if(dynamic_cast<const SprottAttractor*>(&attractor)){
-            rotationX += 0.0003f;
-            rotationY += 0.0001f;
-        }
-
-        for (size_t i = 0; i < points.size(); ++i) {
-            points[i] = attractor.step(points[i]);
-            
-            Matrix rotationmatrixX = Matrix(3, 3);
-            Matrix rotationmatrixY = Matrix(3, 3);
-            Matrix rotationmatrixZ = Matrix(3, 3);
-
-            // Rotation around X-axis
-            rotationmatrixX(0, 0) = 1;
-            rotationmatrixX(1, 1) = cos(rotationX); rotationmatrixX(1, 2) = -sin(rotationX);
-            rotationmatrixX(2, 1) = sin(rotationX); rotationmatrixX(2, 2) = cos(rotationX);
-
-            // Rotation around Y-axis
-            rotationmatrixY(0, 0) = cos(rotationY); rotationmatrixY(0, 2) = sin(rotationY);
-            rotationmatrixY(1, 1) = 1;
-            rotationmatrixY(2, 0) = -sin(rotationY); rotationmatrixY(2, 2) = cos(rotationY);
-
-            // Rotation around Z-axis
-            rotationmatrixZ(0, 0) = cos(rotationZ); rotationmatrixZ(0, 1) = -sin(rotationZ);
-            rotationmatrixZ(1, 0) = sin(rotationZ); rotationmatrixZ(1, 1) = cos(rotationZ);
-            rotationmatrixZ(2, 2) = 1;
-
-            Matrix rotation = matrix_multiplication(matrix_multiplication(rotationmatrixX, rotationmatrixY), rotationmatrixZ);
-
-            Matrix point(3, 1);
-            point(0, 0) = points[i][0];
-            point(1, 0) = points[i][1];
-            point(2, 0) = points[i][2];
-
-            Matrix rotated_2d = matrix_multiplication(rotation, point);
-
-            Matrix projection_matrix(2, 3);
-            projection_matrix(0, 0) = 1; projection_matrix(0, 1) = 0; projection_matrix(0, 2) = 0;
-            projection_matrix(1, 0) = 0; projection_matrix(1, 1) = 1; projection_matrix(1, 2) = 0;
-
-            Matrix projected2d = matrix_multiplication(projection_matrix, rotated_2d);
-
-            float screenX = projected2d(0, 0) * scale + window.getSize().x / 2.0f - offsetX;
-            float screenY = projected2d(1, 0) * scale + window.getSize().y / 2.0f + offsetY;
-
-            sf::Vector2f screenPos(screenX, screenY);
-            
-            trails[i].push_back(sf::Vertex(screenPos, getColorForAmplitude(audioPlayer.getCurrentAmplitude())));
-            if (trails[i].size() > maxTrailSize) {
-                trails[i].erase(trails[i].begin());
-            }
-            if(dynamic_cast<const ThomasAttractor*>(&attractor)){
-                for (size_t j = 0; j < trails[i].size(); ++j) {
-                    float alpha = static_cast<float>(j) / trails[i].size() * 100.0f;
-                    trails[i][j].color.a = static_cast<sf::Uint8>(alpha);
-                }
-            } else{
-                for (size_t j = 0; j < trails[i].size(); ++j) {
-                    float alpha = static_cast<float>(j) / trails[i].size() * 70.0f;
-                    trails[i][j].color.a = static_cast<sf::Uint8>(alpha);
-                }
-            }
-            
-        }
-    }
-
-    sf::Color lerpColor(const sf::Color& start, const sf::Color& end, float t) {
-        // add alpha value
-        return sf::Color(
-            static_cast<sf::Uint8>(start.r + t * (end.r - start.r)),
-            static_cast<sf::Uint8>(start.g + t * (end.g - start.g)),
-            static_cast<sf::Uint8>(start.b + t * (end.b - start.b)),
-            160
-        );
-    }
-
-    sf::Color getColorForAmplitude(float amplitude) {
-        float normalizedAmplitude = std::min(amplitude / attractor.maxamplitude, 1.0f);
-        // sf::Color startColor(115, 210, 222);
-        // sf::Color endColor(216, 17, 89);
-        return lerpColor(attractor.startColor, attractor.endColor, normalizedAmplitude);
-    }
-
-    void render(const std::vector<std::vector<float>>& points, const std::vector<std::vector<sf::Vertex>>& trails) {
+    void render() {
         if (isTransitioning) {
             window.clear(sf::Color::Black);
             transitionFrames--;
@@ -596,56 +418,13 @@ private:
         } else {
             window.clear(sf::Color::Black);
 
-            if(tailon){
-                for (const auto& trail : trails) {
-                    window.draw(&trail[0], trail.size(), sf::PrimitiveType::LineStrip);
-                }
-            }
-
-            sf::CircleShape pointShape(1);
-            for (const auto& p : points) {
-                Matrix rotationmatrixX = Matrix(3, 3);
-                Matrix rotationmatrixY = Matrix(3, 3);
-                Matrix rotationmatrixZ = Matrix(3, 3);
-
-                // Rotation around X-axis
-                rotationmatrixX(0, 0) = 1;
-                rotationmatrixX(1, 1) = cos(rotationX); rotationmatrixX(1, 2) = -sin(rotationX);
-                rotationmatrixX(2, 1) = sin(rotationX); rotationmatrixX(2, 2) = cos(rotationX);
-
-                // Rotation around Y-axis
-                rotationmatrixY(0, 0) = cos(rotationY); rotationmatrixY(0, 2) = sin(rotationY);
-                rotationmatrixY(1, 1) = 1;
-                rotationmatrixY(2, 0) = -sin(rotationY); rotationmatrixY(2, 2) = cos(rotationY);
-
-                // Rotation around Z-axis
-                rotationmatrixZ(0, 0) = cos(rotationZ); rotationmatrixZ(0, 1) = -sin(rotationZ);
-                rotationmatrixZ(1, 0) = sin(rotationZ); rotationmatrixZ(1, 1) = cos(rotationZ);
-                rotationmatrixZ(2, 2) = 1;
-
-                Matrix rotation = matrix_multiplication(matrix_multiplication(rotationmatrixX, rotationmatrixY), rotationmatrixZ);
-
-                Matrix point(3, 1);
-                point(0, 0) = p[0];
-                point(1, 0) = p[1];
-                point(2, 0) = p[2];
-
-                Matrix rotated_2d = matrix_multiplication(rotation, point);
-
-                Matrix projection_matrix(2, 3);
-                projection_matrix(0, 0) = 1; projection_matrix(0, 1) = 0; projection_matrix(0, 2) = 0;
-                projection_matrix(1, 0) = 0; projection_matrix(1, 1) = 1; projection_matrix(1, 2) = 0;
-                
-                Matrix projected2d = matrix_multiplication(projection_matrix, rotated_2d);
-
-                float screenX = projected2d(0, 0) * scale + window.getSize().x / 2.0f - offsetX;
-                float screenY = projected2d(1, 0) * scale + window.getSize().y / 2.0f + offsetY;
-
-                pointShape.setPosition(screenX - pointShape.getRadius(), screenY - pointShape.getRadius());
-                pointShape.setFillColor(getColorForAmplitude(audioPlayer.getCurrentAmplitude()));
-                window.draw(pointShape);
+            {
+                AllocationStage stage("batch");
+                batch.build(scene, tailon, additiveBlend);
             }
 
+            AllocationStage stage("draw");
+            renderer.draw(window, batch, additiveBlend);
         }
         if(menu){
             titletext.setPosition(10.f, window.getSize().y - 170.0f);
@@ -658,6 +437,9 @@ private:
             window.draw(amplitudeText);
             window.draw(commandsText);
             window.draw(offsetText);
+            if (ALLOCATION_TRACKING) {
+                window.draw(allocationText);
+            }
             window.display();
         } else{
             titletext.setPosition(10.f, window.getSize().y - 50.0f);
@@ -669,50 +451,506 @@ private:
     }
 };
 
-int main() {
+void reportExport(const TrajectoryWriter& exporter) {
+    std::cout << "exported " << exporter.frameCount() - exporter.droppedFrames() << " frames";
+    if (exporter.droppedFrames() > 0) {
+        std::cout << ", dropped " << exporter.droppedFrames() << " while the disk was behind";
+    }
+    std::cout << std::endl;
+}
+
+// prints the header of a trajectory file and a summary of one of its frames
+int inspectTrajectory(const std::string& path, uint32_t frame) {
+    TrajectoryReader reader;
+    if (!reader.open(path)) {
+        return 1;
+    }
+    const TrajectoryHeader& header = reader.header();
+    std::cout << reader.frameCount() << " frames in " << reader.chunks().size() << " chunks, every "
+              << header.options.decimation << ". simulated frame, ";
+    if (header.options.quantization > 0.0f) {
+        std::cout << "quantized to " << header.options.quantization << std::endl;
+    } else {
+        std::cout << "full precision" << std::endl;
+    }
+    for (const TrajectoryInstance& instance : header.instances) {
+        std::cout << instance.attractor << " dt " << instance.defdt;
+        for (const auto& parameter : instance.parameters) {
+            std::cout << " " << parameter.first << " " << parameter.second;
+        }
+        std::cout << std::endl;
+    }
+
+    std::vector<TrajectoryPositions> positions;
+    if (!reader.readFrame(frame, positions)) {
+        std::cerr << "Frame " << frame << " is not in " << path << std::endl;
+        return 1;
+    }
+    for (size_t i = 0; i < positions.size(); ++i) {
+        std::array<float, 3> low = {0.0f, 0.0f, 0.0f};
+        std::array<float, 3> high = {0.0f, 0.0f, 0.0f};
+        for (size_t p = 0; p < positions[i].size(); ++p) {
+            for (int c = 0; c < 3; ++c) {
+                low[c] = p == 0 ? positions[i][p][c] : std::min(low[c], positions[i][p][c]);
+                high[c] = p == 0 ? positions[i][p][c] : std::max(high[c], positions[i][p][c]);
+            }
+        }
+        std::cout << "frame " << frame << ", " << header.instances[i].attractor << ": " << positions[i].size() << " particles in ["
+                  << low[0] << ", " << high[0] << "] x [" << low[1] << ", " << high[1] << "] x [" << low[2] << ", " << high[2] << "]" << std::endl;
+    }
+    return 0;
+}
+
+// the scene file's camera settings, if it has any
+void applyCamera(const SceneConfig& config, Scene& scene) {
+    if (config.fov > 0.0f) {
+        scene.fov = config.fov;
+    }
+    if (config.eyeDistance > 0.0f) {
+        scene.eyeDistance = config.eyeDistance;
+    }
+}
+
+// fills a scene from an attractor name or a scene file
+bool buildScene(const std::string& source, Scene& scene) {
+    SceneConfig config;
+    if (makeAttractor(source)) {
+        InstanceConfig instance;
+        instance.attractor = source;
+        config.instances.push_back(instance);
+    } else if (!loadScene(source, config)) {
+        return false;
+    }
+    for (const auto& instance : config.instances) {
+        scene.addInstance(makeAttractor(instance.attractor), instance);
+    }
+    applyCamera(config, scene);
+    return true;
+}
+
+// runs the simulation and batching pipeline without a window or audio and fails if a steady-state frame allocates
+int checkAllocations(Scene& scene, JobSystem& jobs, int frames) {
+    if (!ALLOCATION_TRACKING) {
+        std::cerr << "Allocation tracking is compiled out, build with make instrumented" << std::endl;
+        return 1;
+    }
+    const int warmupFrames = 120;
+    DrawBatch batch(jobs);
+    ViewState view;
+    FrameAllocations& allocations = frameAllocations();
+    scene.initializePoints(1);
+
+    int failedFrames = 0;
+    sf::Clock clock;
+    for (int frame = 0; frame < warmupFrames + frames; ++frame) {
+        if (frame == warmupFrames) {
+            clock.restart();
+        }
+        // a slow sweep through the amplitude range exercises the audio driven paths
+        AudioLevels levels;
+        for (float& band : levels.bands) {
+            band = 400.0f + 400.0f * std::sin(frame * 0.05f);
+        }
+        view.rotationY = frame * 0.002f;
+
+        allocations.beginFrame();
+        {
+            AllocationStage stage("simulate");
+            scene.update(levels, false, view, 1920.0f, 1080.0f, 1.0f / TRAIL_MAX_FRAME_RATE);
+        }
+        {
+            AllocationStage stage("batch");
+            batch.build(scene, true, frame % 2 == 0);
+        }
+        allocations.endFrame();
+
+        if (frame >= warmupFrames && allocations.unexpected() > 0) {
+            std::cout << "frame " << frame << ": " << describeAllocations(allocations) << std::endl;
+            ++failedFrames;
+        }
+    }
+
+    float seconds = clock.getElapsedTime().asSeconds();
+    std::cout << frames << " steady-state frames in " << seconds * 1000.0f << " ms ("
+              << seconds * 1000.0f / frames << " ms/frame), " << failedFrames << " allocating" << std::endl;
+    return failedFrames == 0 ? 0 : 1;
+}
+
+// drives the recorded frames through the simulation and batching pipeline as fast as possible
+// GPU drawing is left out, it would tie the replay to the display's refresh rate; given an image path
+// every frame is also rasterized on the CPU and the last one is written to it
+int replaySession(const std::string& path, const std::string& imagePath, const std::string& exportPath, const TrajectoryOptions& exportOptions) {
+    Session session;
+    JobSystem jobs;
+    Scene scene(jobs);
+    if (!loadSession(path, session) || !buildScene(session.source, scene)) {
+        return 1;
+    }
+    TrajectoryWriter exporter;
+    if (!exportPath.empty() && !exporter.open(exportPath, scene, exportOptions)) {
+        return 1;
+    }
+    DrawBatch batch(jobs);
+    SoftwareRenderer rasterizer(jobs);
+    ViewState view;
+    bool paused = false;
+    bool additive = false;
+    scene.initializePoints(session.seed);
+
+    float slowest = 0.0f;
+    sf::Clock clock;
+    sf::Clock frameClock;
+    for (const SessionFrame& frame : session.frames) {
+        frameClock.restart();
+        for (uint32_t i = 0; i < frame.eventCount; ++i) {
+            applyInput(session.events[frame.firstEvent + i], view, paused, additive, scene);
+        }
+        scene.update(frame.levels, paused, view, session.screenWidth, session.screenHeight, frame.frameTime);
+        if (exporter.isOpen()) {
+            exporter.capture(scene);
+        }
+        batch.build(scene, frame.tails, additive);
+        if (!imagePath.empty()) {
+            rasterizer.rasterize(batch, additive, session.screenWidth, session.screenHeight);
+        }
+        slowest = std::max(slowest, frameClock.getElapsedTime().asSeconds());
+    }
+    float seconds = clock.getElapsedTime().asSeconds();
+    if (exporter.isOpen()) {
+        exporter.close();
+        reportExport(exporter);
+    }
+
+    size_t frames = std::max<size_t>(session.frames.size(), 1);
+    uint64_t hash = outputHash(scene, batch);
+    std::cout << session.frames.size() << " frames of " << session.source << " in " << seconds * 1000.0f << " ms ("
+              << seconds * 1000.0f / frames << " ms/frame, slowest " << slowest * 1000.0f << " ms)" << std::endl;
+    if (!imagePath.empty() && !rasterizer.save(imagePath)) {
+        return 1;
+    }
+    std::cout << "output hash " << std::hex << std::setw(16) << std::setfill('0') << hash << std::dec << std::endl;
+    if (!session.hasHash) {
+        std::cout << "recording has no output hash to compare against" << std::endl;
+        return 0;
+    }
+    if (hash != session.hash) {
+        std::cout << "output differs from the recording" << std::endl;
+        return 1;
+    }
+    std::cout << "output matches the recording" << std::endl;
+    return 0;
+}
+
+// integrates one shard of a density render and writes its hit counts
+int renderDensity(const std::string& source, const std::string& path, const DensityOptions& options, uint32_t shardIndex, uint32_t shardCount) {
+    if (shardCount == 0) {
+        std::cerr << "A density render needs at least one shard" << std::endl;
+        return 1;
+    }
+    if (shardIndex >= shardCount) {
+        std::cerr << "Shard " << shardIndex << " is outside 0.." << shardCount - 1 << std::endl;
+        return 1;
+    }
+    JobSystem jobs;
+    Scene scene(jobs);
+    if (!buildScene(source, scene)) {
+        return 1;
+    }
+    DensityImage image;
+    sf::Clock clock;
+    renderDensityShard(scene, jobs, source, options, shardIndex, shardCount, image);
+    float seconds = clock.getElapsedTime().asSeconds();
+    if (!saveDensityShard(path, image)) {
+        return 1;
+    }
+    std::cout << "shard " << shardIndex << " of " << shardCount << ", " << options.frames << " frames of " << source
+              << " in " << seconds * 1000.0f << " ms" << std::endl;
+    return 0;
+}
+
+// sums density shards and writes the tone mapped image
+int mergeDensity(const std::string& imagePath, const std::vector<std::string>& shardPaths) {
+    DensityImage image;
+    if (!mergeDensityShards(shardPaths, image)) {
+        return 1;
+    }
+    // the gradients come from the scene the shards were rendered from
+    JobSystem jobs(1);
+    Scene scene(jobs);
+    if (!buildScene(image.source, scene) || scene.instances().size() != image.instances.size()) {
+        std::cerr << "Cannot rebuild " << image.source << " for its gradients" << std::endl;
+        return 1;
+    }
+    std::vector<sf::Uint8> pixels;
+    toneMapDensity(image, scene, pixels);
+    sf::Image output;
+    output.create(image.options.width, image.options.height, pixels.data());
+    if (!output.saveToFile(imagePath)) {
+        std::cerr << "Error writing " << imagePath << std::endl;
+        return 1;
+    }
+    std::cout << "merged " << shardPaths.size() << " shards, density hash " << std::hex << std::setw(16) << std::setfill('0')
+              << densityHash(image) << std::dec << std::endl;
+    return 0;
+}
+
+// a whole argument as a number, false on anything else
+static bool parseFloat(const char* text, float& value) {
+    char* end = nullptr;
+    value = std::strtof(text, &end);
+    return end != text && *end == '\0';
+}
+
+// a whole argument as an unsigned number no larger than max, false on anything else, signs included
+static bool parseUnsigned(const char* text, unsigned long max, unsigned long& value) {
+    if (!std::isdigit(static_cast<unsigned char>(text[0]))) {
+        return false;
+    }
+    errno = 0;
+    char* end = nullptr;
+    value = std::strtoul(text, &end, 10);
+    return errno == 0 && *end == '\0' && value <= max;
+}
+
+// <width>x<height>, each side between 1 and DENSITY_MAX_SIZE
+static bool parseSize(const char* text, uint32_t& width, uint32_t& height) {
+    const char* separator = std::strchr(text, 'x');
+    unsigned long w, h;
+    if (!separator || !parseUnsigned(std::string(text, separator).c_str(), DENSITY_MAX_SIZE, w) ||
+        !parseUnsigned(separator + 1, DENSITY_MAX_SIZE, h) || w == 0 || h == 0) {
+        return false;
+    }
+    width = static_cast<uint32_t>(w);
+    height = static_cast<uint32_t>(h);
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    // the render loop and the headless checks run on this thread
+    trackAllocationsOnThisThread();
+
+    // options in front of the usual arguments:
+    // --record <log> writes the session to a log for --replay, --software rasterizes on the CPU instead of through SFML,
+    // --export <file> streams particle positions to a trajectory file, thinned by --decimate <n> and --quantize <step>,
+    // --publish shares the live particle state with other processes through shared memory,
+    // --seed <n>, --frames <n> and --size <w>x<h> set up --density renders,
+    // --fov <degrees> and --distance <factor> set up the perspective camera, overriding the scene file
+    std::string recordPath;
+    std::string exportPath;
+    TrajectoryOptions exportOptions;
+    bool softwareRendering = false;
+    bool publishing = false;
+    DensityOptions densityOptions;
+    SceneConfig cameraOptions;
+    while (argc > 1) {
+        std::string option = argv[1];
+        int used = 1;
+        if (option == "--record" && argc > 2) {
+            recordPath = argv[2];
+            used = 2;
+        } else if (option == "--export" && argc > 2) {
+            exportPath = argv[2];
+            used = 2;
+        } else if (option == "--decimate" && argc > 2) {
+            unsigned long decimation;
+            if (!parseUnsigned(argv[2], UINT32_MAX, decimation) || decimation == 0) {
+                std::cerr << "--decimate takes a frame interval of 1 or more, not " << argv[2] << std::endl;
+                return 1;
+            }
+            exportOptions.decimation = static_cast<unsigned>(decimation);
+            used = 2;
+        } else if (option == "--quantize" && argc > 2) {
+            if (!parseFloat(argv[2], exportOptions.quantization) || !(exportOptions.quantization >= 0.0f) ||
+                std::isinf(exportOptions.quantization)) {
+                std::cerr << "--quantize takes a grid step of 0 (full precision) or more, not " << argv[2] << std::endl;
+                return 1;
+            }
+            used = 2;
+        } else if (option == "--fov" && argc > 2) {
+            float degrees;
+            if (!parseFloat(argv[2], degrees) || degrees < 10.0f || degrees > 150.0f) {
+                std::cerr << "--fov takes a field of view between 10 and 150 degrees, not " << argv[2] << std::endl;
+                return 1;
+            }
+            cameraOptions.fov = degrees * static_cast<float>(M_PI) / 180.0f;
+            used = 2;
+        } else if (option == "--distance" && argc > 2) {
+            if (!parseFloat(argv[2], cameraOptions.eyeDistance) || cameraOptions.eyeDistance < 0.25f || cameraOptions.eyeDistance > 10.0f) {
+                std::cerr << "--distance takes a camera distance factor between 0.25 and 10, not " << argv[2] << std::endl;
+                return 1;
+            }
+            used = 2;
+        } else if (option == "--software") {
+            softwareRendering = true;
+        } else if (option == "--publish") {
+            publishing = true;
+        } else if (option == "--seed" && argc > 2) {
+            unsigned long seed;
+            if (!parseUnsigned(argv[2], UINT32_MAX, seed)) {
+                std::cerr << "--seed takes a number between 0 and " << UINT32_MAX << ", not " << argv[2] << std::endl;
+                return 1;
+            }
+            densityOptions.seed = static_cast<unsigned>(seed);
+            used = 2;
+        } else if (option == "--frames" && argc > 2) {
+            unsigned long frames;
+            if (!parseUnsigned(argv[2], UINT32_MAX, frames) || frames == 0) {
+                std::cerr << "--frames takes a frame count of 1 or more, not " << argv[2] << std::endl;
+                return 1;
+            }
+            densityOptions.frames = static_cast<uint32_t>(frames);
+            used = 2;
+        } else if (option == "--size" && argc > 2) {
+            if (!parseSize(argv[2], densityOptions.width, densityOptions.height)) {
+                std::cerr << "--size takes <width>x<height> with sides between 1 and " << DENSITY_MAX_SIZE << ", not " << argv[2] << std::endl;
+                return 1;
+            }
+            used = 2;
+        } else {
+            break;
+        }
+        argv += used;
+        argc -= used;
+    }
+
+    if (argc > 2 && std::string(argv[1]) == "--check-allocations") {
+        // --check-allocations <attractor|scene> [frames]
+        JobSystem jobs;
+        Scene scene(jobs);
+        if (!buildScene(argv[2], scene)) {
+            return 1;
+        }
+        unsigned long frames = 600;
+        if (argc > 3 && !parseUnsigned(argv[3], INT32_MAX, frames)) {
+            std::cerr << "--check-allocations takes a frame count, not " << argv[3] << std::endl;
+            return 1;
+        }
+        return checkAllocations(scene, jobs, static_cast<int>(frames));
+    }
+    if (argc > 2 && std::string(argv[1]) == "--replay") {
+        // --replay <log> [image]
+        return replaySession(argv[2], argc > 3 ? argv[3] : "", exportPath, exportOptions);
+    }
+    if (argc > 2 && std::string(argv[1]) == "--inspect") {
+        // --inspect <trajectory> [frame]
+        unsigned long frame = 0;
+        if (argc > 3 && !parseUnsigned(argv[3], UINT32_MAX, frame)) {
+            std::cerr << "--inspect takes a frame number, not " << argv[3] << std::endl;
+            return 1;
+        }
+        return inspectTrajectory(argv[2], static_cast<uint32_t>(frame));
+    }
+    if (argc > 3 && std::string(argv[1]) == "--density") {
+        // --density <attractor|scene> <shard file> [shard index] [shard count]
+        unsigned long shardIndex = 0, shardCount = 1;
+        if ((argc > 4 && !parseUnsigned(argv[4], UINT32_MAX, shardIndex)) || (argc > 5 && !parseUnsigned(argv[5], UINT32_MAX, shardCount))) {
+            std::cerr << "--density takes a shard index and a shard count, not " << argv[4] << (argc > 5 ? " " : "") << (argc > 5 ? argv[5] : "") << std::endl;
+            return 1;
+        }
+        return renderDensity(argv[2], argv[3], densityOptions, static_cast<uint32_t>(shardIndex), static_cast<uint32_t>(shardCount));
+    }
+    if (argc > 3 && std::string(argv[1]) == "--merge") {
+        // --merge <image> <shard files...>
+        return mergeDensity(argv[2], std::vector<std::string>(argv + 3, argv + argc));
+    }
+
+    StartupReport report;
+    report.begin("scene setup");
     AudioPlayer audioPlayer;
-    std::string attractorchoice;
-    std::unique_ptr<Attractor> attractor;
+    JobSystem jobs;
+    Scene scene(jobs);
     std::string title;
-    sf::VideoMode desktopMode = sf::VideoMode::getFullscreenModes()[0];
-    std::cout << std::endl << "==== Chaos Attractor Music Visualizer ====" << std::endl;
-    std::cout << "Available Attractors:" << std::endl;
-    std::cout << "1. Thomas" << std::endl;
-    std::cout << "2. Halvorsen" << std::endl;
-    std::cout << "3. Sprott" << std::endl;
-    std::cout << "4. Aizawa" << std::endl;
-    std::cout << "5. Lorenz" << std::endl;
-    std::cout << "Enter the name of an attractor: ";
-    std::cin >> attractorchoice;
-
-    if(attractorchoice == "Lorenz") {
-        attractor = std::make_unique<LorenzAttractor>(lorenz_defdt);
-        title = "Lorenz Attractor";
-    } else if(attractorchoice == "Aizawa") {
-        attractor = std::make_unique<AizawaAttractor>(aizawa_defdt);
-        title = "Aizawa Attractor";
-    } else if(attractorchoice == "Thomas") {
-        attractor = std::make_unique<ThomasAttractor>(thomas_defdt);
-        title = "Thomas Attractor";
-    } else if(attractorchoice == "Halvorsen") {
-        attractor = std::make_unique<HalvorsenAttractor>(halvorsen_defdt);
-        title = "Halvorsen Attractor";
-    } else if(attractorchoice == "Sprott") {
-        attractor = std::make_unique<SprottAttractor>(sprott_defdt);
-        title = "Sprott Attractor";
+    std::string audioPath;
+    std::string source;
+
+    if (argc > 1 && makeAttractor(argv[1])) {
+        // attractor name on the command line skips the prompt
+        InstanceConfig instance;
+        instance.attractor = argv[1];
+        std::unique_ptr<Attractor> attractor = makeAttractor(instance.attractor);
+        // optional second argument: an audio file, a directory or a playlist file
+        audioPath = argc > 2 ? argv[2] : attractor->defaultaudio;
+        scene.addInstance(std::move(attractor), instance);
+        title = instance.attractor + " Attractor";
+        source = instance.attractor;
+    } else if (argc > 1) {
+        // scene file with one or more attractor instances
+        SceneConfig config;
+        if (!loadScene(argv[1], config)) {
+            return 1;
+        }
+        for (const auto& instance : config.instances) {
+            scene.addInstance(makeAttractor(instance.attractor), instance);
+            title += (title.empty() ? "" : " + ") + instance.attractor + " Attractor";
+        }
+        applyCamera(config, scene);
+        audioPath = config.audio.empty() ? scene.instances().front().attractor->defaultaudio : config.audio;
+        source = argv[1];
     } else {
-        std::cout << "Invalid attractor choice. Please try again.";
-        return 1;
+        std::string attractorchoice;
+        std::cout << std::endl << "==== Chaos Attractor Music Visualizer ====" << std::endl;
+        std::cout << "Available Attractors:" << std::endl;
+        std::cout << "1. Thomas" << std::endl;
+        std::cout << "2. Halvorsen" << std::endl;
+        std::cout << "3. Sprott" << std::endl;
+        std::cout << "4. Aizawa" << std::endl;
+        std::cout << "5. Lorenz" << std::endl;
+        std::cout << "Enter the name of an attractor: ";
+        std::cin >> attractorchoice;
+        report.restart();
+        report.begin("scene setup");
+
+        std::unique_ptr<Attractor> attractor = makeAttractor(attractorchoice);
+        if (!attractor) {
+            std::cout << "Invalid attractor choice. Please try again.";
+            return 1;
+        }
+        InstanceConfig instance;
+        instance.attractor = attractorchoice;
+        audioPath = attractor->defaultaudio;
+        scene.addInstance(std::move(attractor), instance);
+        title = attractorchoice + " Attractor";
+        source = attractorchoice;
     }
 
-    if (!audioPlayer.loadAndPlay(attractor->defaultaudio)) {
-        std::cerr << "Error loading audio" << std::endl;
+    applyCamera(cameraOptions, scene);
+    report.end("scene setup");
+
+    SessionRecorder recorder;
+    if (!recordPath.empty() && !recorder.open(recordPath, source)) {
+        return 1;
+    }
+    TrajectoryWriter exporter;
+    if (!exportPath.empty() && !exporter.open(exportPath, scene, exportOptions)) {
+        return 1;
+    }
+    SharedStatePublisher publisher;
+    if (publishing && !publisher.open(scene)) {
         return 1;
     }
+    FrameOutputs outputs;
+    outputs.recorder = recorder.isOpen() ? &recorder : nullptr;
+    outputs.exporter = exporter.isOpen() ? &exporter : nullptr;
+    outputs.publisher = publisher.isOpen() ? &publisher : nullptr;
+
+    // decoding runs alongside window creation and the first frames
+    audioPlayer.loadAsync(audioPath, &report);
+
+    std::unique_ptr<Renderer> renderer;
+    if (softwareRendering) {
+        renderer = std::make_unique<SoftwareRenderer>(jobs);
+    } else {
+        renderer = std::make_unique<SfmlRenderer>();
+    }
 
-    Visualization vis(desktopMode.width, desktopMode.height, title, audioPlayer, *attractor);
-    vis.run(*attractor);
-    audioPlayer.sound.stop();
+    report.begin("window");
+    Visualization vis(sf::VideoMode::getFullscreenModes()[0], title, audioPlayer, scene, jobs, report, *renderer, outputs);
+    vis.run();
+    audioPlayer.stop();
+    if (exporter.isOpen()) {
+        exporter.close();
+        reportExport(exporter);
+    }
 
     return 0;
 }
\ No newline at end of file